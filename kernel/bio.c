@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -23,69 +23,156 @@
 #include "fs.h"
 #include "buf.h"
 
-struct {
+// Buffers are hashed by (dev, blockno) into NBUCKET buckets,
+// each with its own lock, so lookups of different blocks don't
+// contend.  A buffer's dev, blockno and bucket only change while
+// its refcnt is 0, under its bucket's lock.  On a miss, bget()
+// recycles the least recently released free buffer: from the
+// block's own bucket if it has one, else from whichever bucket
+// holds the oldest, taking one bucket lock at a time.  An empty
+// buffer has dev 0, which no disk uses, and its bucket's index
+// as blockno.
+
+#define BHASH(dev, blockno) (((((uint64)(dev)) << 32) | (blockno)) % NBUCKET)
+
+struct bucket {
   struct spinlock lock;
-  struct buf buf[NBUF];
+  struct buf *head;   // buffers whose blocks hash here
+};
 
-  // Linked list of all buffers, through prev/next.
-  // Sorted by how recently the buffer was used.
-  // head.next is most recent, head.prev is least.
-  struct buf head;
+struct {
+  struct buf buf[NBUF];
+  struct bucket bucket[NBUCKET];
 } bcache;
 
 void
 binit(void)
 {
+  struct bucket *bk;
   struct buf *b;
 
-  initlock(&bcache.lock, "bcache");
+  for(bk = bcache.bucket; bk < bcache.bucket+NBUCKET; bk++)
+    initlock(&bk->lock, "bcache");
 
-  // Create linked list of buffers
-  bcache.head.prev = &bcache.head;
-  bcache.head.next = &bcache.head;
+  // spread the empty buffers over the buckets.
   for(b = bcache.buf; b < bcache.buf+NBUF; b++){
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
+    b->dev = 0;
+    b->blockno = (b - bcache.buf) % NBUCKET;
+    bk = &bcache.bucket[b->blockno];
+    b->next = bk->head;
+    bk->head = b;
     initsleeplock(&b->lock, "buffer");
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
   }
 }
 
-// Look through buffer cache for block on device dev.
-// If not found, allocate a buffer.
-// In either case, return locked buffer.
+// Find the buffer for block blockno on dev in bk, which
+// must be locked, and take a reference to it.
 static struct buf*
-bget(uint dev, uint blockno)
+bfind(struct bucket *bk, uint dev, uint blockno)
 {
   struct buf *b;
 
-  acquire(&bcache.lock);
-
-  // Is the block already cached?
-  for(b = bcache.head.next; b != &bcache.head; b = b->next){
+  for(b = bk->head; b; b = b->next){
     if(b->dev == dev && b->blockno == blockno){
       b->refcnt++;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
       return b;
     }
   }
+  return 0;
+}
+
+// The least recently released free buffer in bk, which
+// must be locked, or 0 if all are in use.
+static struct buf*
+blru(struct bucket *bk)
+{
+  struct buf *b, *lru = 0;
+
+  for(b = bk->head; b; b = b->next)
+    if(b->refcnt == 0 && (lru == 0 || b->lastuse < lru->lastuse))
+      lru = b;
+  return lru;
+}
 
-  // Not cached.
-  // Recycle the least recently used (LRU) unused buffer.
-  for(b = bcache.head.prev; b != &bcache.head; b = b->prev){
-    if(b->refcnt == 0) {
-      b->dev = dev;
-      b->blockno = blockno;
-      b->valid = 0;
-      b->refcnt = 1;
-      release(&bcache.lock);
-      acquiresleep(&b->lock);
+// Take the least recently released free buffer out of
+// whichever bucket it is in.  The caller holds no bucket lock.
+static struct buf*
+bsteal(void)
+{
+  struct bucket *bk, *best;
+  struct buf *b, **bp;
+  uint64 oldest = 0;
+
+  for(;;){
+    best = 0;
+    for(bk = bcache.bucket; bk < bcache.bucket+NBUCKET; bk++){
+      acquire(&bk->lock);
+      if((b = blru(bk)) != 0 && (best == 0 || b->lastuse < oldest)){
+        best = bk;
+        oldest = b->lastuse;
+      }
+      release(&bk->lock);
+    }
+    if(best == 0)
+      panic("bget: no buffers");
+
+    // the buffers may have changed since; take the
+    // oldest free one there now, if any.
+    acquire(&best->lock);
+    if((b = blru(best)) != 0){
+      for(bp = &best->head; *bp != b; bp = &(*bp)->next)
+        ;
+      *bp = b->next;
+      release(&best->lock);
       return b;
     }
+    release(&best->lock);
+  }
+}
+
+// Look through buffer cache for block on device dev.
+// If not found, allocate a buffer.
+// In either case, return locked buffer.
+static struct buf*
+bget(uint dev, uint blockno)
+{
+  struct bucket *bk = &bcache.bucket[BHASH(dev, blockno)];
+  struct buf *b, *nb;
+
+  acquire(&bk->lock);
+
+  // Is the block already cached?
+  if((b = bfind(bk, dev, blockno)) != 0)
+    goto found;
+
+  // Not cached.  Recycle a free buffer in this bucket,
+  // or take one from another.
+  if((b = blru(bk)) == 0){
+    release(&bk->lock);
+    nb = bsteal();
+    acquire(&bk->lock);
+    nb->next = bk->head;
+    bk->head = nb;
+    // another process may have cached the block meanwhile;
+    // if so, leave nb here empty.
+    if((b = bfind(bk, dev, blockno)) != 0){
+      nb->dev = 0;
+      nb->blockno = bk - bcache.bucket;
+      nb->valid = 0;
+      nb->lastuse = 0;
+      goto found;
+    }
+    b = nb;
   }
-  panic("bget: no buffers");
+  b->dev = dev;
+  b->blockno = blockno;
+  b->valid = 0;
+  b->refcnt = 1;
+
+ found:
+  release(&bk->lock);
+  acquiresleep(&b->lock);
+  return b;
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -112,42 +199,41 @@ bwrite(struct buf *b)
 }
 
 // Release a locked buffer.
-// Move to the head of the most-recently-used list.
+// Note when it was last used, for eviction.
 void
 brelse(struct buf *b)
 {
+  struct bucket *bk;
+
   if(!holdingsleep(&b->lock))
     panic("brelse");
 
   releasesleep(&b->lock);
 
-  acquire(&bcache.lock);
+  bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+  acquire(&bk->lock);
   b->refcnt--;
   if (b->refcnt == 0) {
     // no one is waiting for it.
-    b->next->prev = b->prev;
-    b->prev->next = b->next;
-    b->next = bcache.head.next;
-    b->prev = &bcache.head;
-    bcache.head.next->prev = b;
-    bcache.head.next = b;
+    b->lastuse = r_time();
   }
-  
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+
+  acquire(&bk->lock);
   b->refcnt++;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
 
 void
 bunpin(struct buf *b) {
-  acquire(&bcache.lock);
+  struct bucket *bk = &bcache.bucket[BHASH(b->dev, b->blockno)];
+
+  acquire(&bk->lock);
   b->refcnt--;
-  release(&bcache.lock);
+  release(&bk->lock);
 }
-
-
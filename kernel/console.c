@@ -86,7 +86,7 @@ int
 consoleread(int user_dst, uint64 dst, int n)
 {
   uint target;
-  int c;
+  int c, r;
   char cbuf;
 
   target = n;
@@ -102,21 +102,33 @@ consoleread(int user_dst, uint64 dst, int n)
       sleep(&cons.r, &cons.lock);
     }
 
-    c = cons.buf[cons.r++ % INPUT_BUF_SIZE];
+    c = cons.buf[cons.r % INPUT_BUF_SIZE];
 
     if(c == C('D')){  // end-of-file
-      if(n < target){
-        // Save ^D for next time, to make sure
+      if(n == target){
+        // Otherwise save ^D for next time, to make sure
         // caller gets a 0-byte result.
-        cons.r--;
+        cons.r++;
       }
       break;
     }
 
-    // copy the input byte to the user-space buffer.
+    // copy the input byte to the user-space buffer,
+    // taking it from cons.buf only once that worked.
     cbuf = c;
-    if(either_copyout(user_dst, dst, &cbuf, 1) == -1)
-      break;
+    if(either_copyout(user_dst, dst, &cbuf, 1) == -1){
+      if(!user_dst)
+        break;
+      // the page may need a fault that sleeps, as in
+      // pipewrite(); take it without the lock and look again.
+      release(&cons.lock);
+      r = ufault(myproc()->pagetable, dst, 1, 1);
+      acquire(&cons.lock);
+      if(r < 0)
+        break;
+      continue;
+    }
+    cons.r++;
 
     dst++;
     --n;
@@ -1,6 +1,7 @@
 struct buf;
 struct context;
 struct file;
+struct kmem_cache;
 struct inode;
 struct pipe;
 struct proc;
@@ -8,6 +9,8 @@ struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct swapstat;
+struct ucursor;
 
 // bio.c
 void            binit(void);
@@ -57,10 +60,17 @@ void            ireclaim(int);
 
 // kalloc.c
 void*           kalloc(void);
+void*           kzalloc(void);
+void*           kalloc_order(int);
+void            kfree_order(void*, int);
+void            ksplit(void*, int);
+int             kzfill(void);
+void            kref(void*);
+int             krefcnt(void*);
 void            kfree(void *);
 void            kinit(void);
 uint64          getfreepages(void);
-void            getmemstat(uint64*, uint64*);
+void            getmemstat(uint64*, uint64*, uint64*);
 
 // log.c
 void            initlog(int, struct superblock*);
@@ -68,7 +78,19 @@ void            log_write(struct buf*);
 void            begin_op(void);
 void            end_op(void);
 
+// mmap.c
+void            mmapinit(void);
+uint64          fpageget(struct inode*, uint);
+void            fpageput(struct inode*, uint);
+uint64          vmabase(struct proc*);
+uint64          vmafault(struct proc*, uint64, int);
+uint64          vmamap(struct file*, uint64, int, int, uint);
+int             vmaunmap(struct proc*, uint64, uint64);
+void            vmafree(struct proc*);
+int             vmacopy(struct proc*, struct proc*);
+
 // pipe.c
+void            pipeinit(void);
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
 int             piperead(struct pipe*, uint64, int);
@@ -89,7 +111,7 @@ pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
 int             kkill(int);
 int             killed(struct proc*);
-void            setkilled(struct proc*);
+void            setkilled(struct proc*, int);
 struct cpu*     mycpu(void);
 struct proc*    myproc();
 void            procinit(void);
@@ -103,6 +125,16 @@ void            yield(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
+int             setsched(int);
+int             lendtickets(int);
+int             mkcurrency(int);
+int             setmemlimit(int);
+int             mkmemgroup(int);
+int             setquantum(int);
+int             getpinfo(uint64, int);
+int             getminfo(uint64, int);
+void            randinithart(void);
+void            randtest(void);
 
 // swtch.S
 void            swtch(struct context*, struct context*);
@@ -110,11 +142,19 @@ void            swtch(struct context*, struct context*);
 // spinlock.c
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
+int             holdingspin(void);
 void            initlock(struct spinlock*, char*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
+// slab.c
+void            slabinit(void);
+struct kmem_cache* kmem_cache_create(char*, uint);
+void*           kmem_cache_alloc(struct kmem_cache*);
+void            kmem_cache_free(struct kmem_cache*, void*);
+int             slabstat(uint64, int);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
@@ -130,6 +170,15 @@ int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
 char*           strncpy(char*, const char*, int);
 
+// swap.c
+void            swapinit(int, struct superblock*);
+int             swapout(int);
+int             swapreclaim(int);
+uint64          swapin(pte_t*);
+void            swapdup(uint);
+void            swapfree(uint);
+void            getswapstat(struct swapstat*);
+
 // syscall.c
 void            argint(int, int*);
 int             argstr(int, char*, int);
@@ -144,6 +193,8 @@ void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
 void            prepare_return(void);
+void            timerset(void);
+int             settickless(int);
 
 // uart.c
 void            uartinit(void);
@@ -156,21 +207,40 @@ int             uartgetc(void);
 void            kvminit(void);
 void            kvminithart(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
+int             kvmcreate(struct proc*);
+void            kvmfree(struct proc*);
+void            kvmrelink(struct proc*);
+void            kvmswitch(struct proc*);
+uint64          uvmsatp(struct proc*);
+void            uvmflush(pagetable_t, uint64, uint64);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
-pagetable_t     uvmcreate(void);
+pagetable_t     uvmcreate(struct proc*);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             uvmroom(struct proc*);
+int             uvmlimit(struct proc*);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
 pte_t *         walk(pagetable_t, uint64, int);
+pte_t *         walkmega(pagetable_t, uint64, int);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
 int             copyin(pagetable_t, char *, uint64, uint64);
 int             copyinstr(pagetable_t, char *, uint64, uint64);
+void            uinit(struct ucursor*, pagetable_t);
+int             ucopyout(struct ucursor*, uint64, char *, uint64);
+int             ucopyin(struct ucursor*, char *, uint64, uint64);
+int             ufault(pagetable_t, uint64, uint64, int);
 int             ismapped(pagetable_t, uint64);
+uint64          cowfault(pagetable_t, uint64);
 uint64          vmfault(pagetable_t, uint64, int);
+int             uvmadvise(uint64, uint64, int);
+
+// ucopy.S
+int             ucopy(void*, const void*, uint64);
+int             ucopystr(char*, const char*, uint64);
 
 // plic.c
 void            plicinit(void);
@@ -128,12 +128,16 @@ kexec(char *path, char **argv)
   safestrcpy(p->name, last, sizeof(p->name));
     
   // Commit to the user image.
+  vmafree(p);
   oldpagetable = p->pagetable;
   p->pagetable = pagetable;
+  kvmrelink(p);
   p->sz = sz;
+  p->guard = stackbase - PGSIZE;
   p->trapframe->epc = elf.entry;  // initial program counter = ulib.c:start()
   p->trapframe->sp = sp; // initial stack pointer
   proc_freepagetable(oldpagetable, oldsz);
+  p->acct.peak = p->acct.rss;
 
   return argc; // this ends up in a0, the first argument to main(argc, argv)
 
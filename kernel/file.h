@@ -18,6 +18,8 @@ struct inode {
   uint dev;           // Device number
   uint inum;          // Inode number
   int ref;            // Reference count
+  struct inode *next; // on itable.list
+  int nfpage;         // MAP_SHARED pages in fpages, under its lock
   struct sleeplock lock; // protects everything below here
   int valid;          // inode has been read from disk?
 
@@ -45,6 +45,7 @@ fsinit(int dev) {
     panic("invalid file system");
   initlog(dev, &sb);
   ireclaim(dev);
+  swapinit(dev, &sb);
 }
 
 // Zero a block.
@@ -166,28 +167,29 @@ bfree(int dev, uint b)
 // multi-step atomic operations.
 //
 // The itable.lock spin-lock protects the allocation of itable
-// entries. Since ip->ref indicates whether an entry is free,
-// and ip->dev and ip->inum indicate which i-node an entry
-// holds, one must hold itable.lock while using any of those fields.
+// entries. In-memory inodes come from a slab cache and sit on
+// itable.list while ip->ref > 0; iput() frees them when ref
+// drops to 0. ip->dev and ip->inum indicate which i-node an
+// entry holds, so one must hold itable.lock while using ref,
+// dev, inum, or next.
 //
 // An ip->lock sleep-lock protects all ip-> fields other than ref,
-// dev, and inum.  One must hold ip->lock in order to
+// dev, inum, and next.  One must hold ip->lock in order to
 // read or write that inode's ip->valid, ip->size, ip->type, &c.
 
 struct {
   struct spinlock lock;
-  struct inode inode[NINODE];
+  struct inode *list;   // inodes with ref > 0
+  int ninode;
 } itable;
 
+static struct kmem_cache *inodecache;
+
 void
 iinit()
 {
-  int i = 0;
-  
   initlock(&itable.lock, "itable");
-  for(i = 0; i < NINODE; i++) {
-    initsleeplock(&itable.inode[i].lock, "inode");
-  }
+  inodecache = kmem_cache_create("inode", sizeof(struct inode));
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -247,27 +249,31 @@ iupdate(struct inode *ip)
 static struct inode*
 iget(uint dev, uint inum)
 {
-  struct inode *ip, *empty;
+  struct inode *ip;
 
   acquire(&itable.lock);
 
   // Is the inode already in the table?
-  empty = 0;
-  for(ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++){
-    if(ip->ref > 0 && ip->dev == dev && ip->inum == inum){
+  for(ip = itable.list; ip != 0; ip = ip->next){
+    if(ip->dev == dev && ip->inum == inum){
       ip->ref++;
       release(&itable.lock);
       return ip;
     }
-    if(empty == 0 && ip->ref == 0)    // Remember empty slot.
-      empty = ip;
   }
 
-  // Recycle an inode entry.
-  if(empty == 0)
+  // Allocate an inode entry.  NINODE is a soft limit: past
+  // it, only while free memory is above SOFTRESERVE pages.
+  if(itable.ninode >= NINODE && getfreepages() < SOFTRESERVE)
+    panic("iget: no inodes");
+  if((ip = kmem_cache_alloc(inodecache)) == 0)
     panic("iget: no inodes");
+  memset(ip, 0, sizeof(*ip));
+  initsleeplock(&ip->lock, "inode");
+  ip->next = itable.list;
+  itable.list = ip;
+  itable.ninode++;
 
-  ip = empty;
   ip->dev = dev;
   ip->inum = inum;
   ip->ref = 1;
@@ -359,6 +365,16 @@ iput(struct inode *ip)
   }
 
   ip->ref--;
+  if(ip->ref == 0){
+    struct inode **pp;
+    for(pp = &itable.list; *pp != ip; pp = &(*pp)->next)
+      ;
+    *pp = ip->next;
+    itable.ninode--;
+    release(&itable.lock);
+    kmem_cache_free(inodecache, ip);
+    return;
+  }
   release(&itable.lock);
 }
 
@@ -496,6 +512,8 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
 {
   uint tot, m;
   struct buf *bp;
+  uint64 pa;
+  int r;
 
   if(off > ip->size || off + n < off)
     return 0;
@@ -503,17 +521,23 @@ readi(struct inode *ip, int user_dst, uint64 dst, uint off, uint n)
     n = ip->size - off;
 
   for(tot=0; tot<n; tot+=m, off+=m, dst+=m){
-    uint addr = bmap(ip, off/BSIZE);
-    if(addr == 0)
-      break;
-    bp = bread(ip->dev, addr);
     m = min(n - tot, BSIZE - off%BSIZE);
-    if(either_copyout(user_dst, dst, bp->data + (off % BSIZE), m) == -1) {
+    // a MAP_SHARED page may hold stores not yet written back.
+    if((pa = fpageget(ip, off)) != 0){
+      r = either_copyout(user_dst, dst, (char*)pa + (off % PGSIZE), m);
+      fpageput(ip, off);
+    } else {
+      uint addr = bmap(ip, off/BSIZE);
+      if(addr == 0)
+        break;
+      bp = bread(ip->dev, addr);
+      r = either_copyout(user_dst, dst, bp->data + (off % BSIZE), m);
       brelse(bp);
+    }
+    if(r == -1) {
       tot = -1;
       break;
     }
-    brelse(bp);
   }
   return tot;
 }
@@ -530,6 +554,7 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
 {
   uint tot, m;
   struct buf *bp;
+  uint64 pa;
 
   if(off > ip->size || off + n < off)
     return -1;
@@ -547,6 +572,11 @@ writei(struct inode *ip, int user_src, uint64 src, uint off, uint n)
       break;
     }
     log_write(bp);
+    // keep a MAP_SHARED page of this block in step.
+    if((pa = fpageget(ip, off)) != 0){
+      memmove((char*)pa + (off % PGSIZE), bp->data + (off % BSIZE), m);
+      fpageput(ip, off);
+    }
     brelse(bp);
   }
 
@@ -1,6 +1,8 @@
 // Physical memory allocator, for user processes,
 // kernel stacks, page-table pages,
-// and pipe buffers. Allocates whole 4096-byte pages.
+// and pipe buffers. Allocates whole 4096-byte pages,
+// or with kalloc_order() physically contiguous blocks
+// of 2^order pages from a buddy system.
 
 #include "types.h"
 #include "param.h"
@@ -16,21 +18,61 @@ extern char end[]; // first address after kernel.
 
 struct run {
   struct run *next;
+  struct run *prev;  // buddy free lists only
 };
 
+#define NPAGE ((PHYSTOP - KERNBASE) / PGSIZE)
+#define PAGEIDX(pa) (((uint64)(pa) - KERNBASE) / PGSIZE)
+#define PAGEADDR(i) ((struct run*)(KERNBASE + (uint64)(i) * PGSIZE))
+
+// The global pool, a buddy system: free blocks of 2^k pages,
+// aligned to their size, on freelist[k].  A freed block merges
+// with its buddy (the other half of the 2^(k+1) block) when
+// that is free too.  CPUs move single pages to and from it
+// KBATCH at a time.
 struct {
   struct spinlock lock;
-  struct run *freelist;
-  uint64 nfree;      // Number of free pages (Phase 2: Memory Stats)
-  uint64 nalloc;     // Total allocations (Phase 2: Memory Stats)
+  struct run *freelist[MAXORDER+1];
+  uint64 nblocks[MAXORDER+1];  // Blocks on each freelist
+  uint64 nfree;      // Free pages in the pool (Phase 2: Memory Stats)
+  uchar order[NPAGE];  // 1 + order of the free block starting at each page, or 0
 } kmem;
 
+// Each CPU allocates from and frees to its own list, so
+// kalloc() and kfree() normally take only an uncontended lock.
+// A kcpu lock may be held while acquiring kmem.lock, but never
+// while acquiring another kcpu lock.
+struct kcpu {
+  struct spinlock lock;
+  struct run *freelist;
+  uint64 nfree;      // Pages on freelist
+  uint64 nalloc;     // Allocations made by this CPU; only it writes this
+} kcpus[NCPU];
+
+// Free pages zeroed ahead of time by idle CPUs, for kzalloc().
+struct {
+  struct spinlock lock;
+  struct run *freelist;
+  uint64 nfree;
+} kzero;
+
+// Reference counts for every physical page, so copy-on-write
+// fork can share pages.  kalloc() sets a page's count to 1,
+// kref() adds sharers, and kfree() frees it when the count
+// drops to 0.
+static int pgref[(PHYSTOP - KERNBASE) / PGSIZE];
+#define PGREF(pa) pgref[((uint64)(pa) - KERNBASE) / PGSIZE]
+
+static struct run *ksteal(struct kcpu*);
+static void kdrain(struct kcpu*, int);
+
 void
 kinit()
 {
   initlock(&kmem.lock, "kmem");
-  kmem.nfree = 0;
-  kmem.nalloc = 0;
+  initlock(&kzero.lock, "kzero");
+  for(int i = 0; i < NCPU; i++)
+    initlock(&kcpus[i].lock, "kcpu");
   freerange(end, (void*)PHYSTOP);
 }
 
@@ -39,8 +81,10 @@ freerange(void *pa_start, void *pa_end)
 {
   char *p;
   p = (char*)PGROUNDUP((uint64)pa_start);
-  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+  for(; p + PGSIZE <= (char*)pa_end; p += PGSIZE){
+    PGREF(p) = 1;
     kfree(p);
+  }
 }
 
 // Free the page of physical memory pointed at by pa,
@@ -51,20 +95,197 @@ void
 kfree(void *pa)
 {
   struct run *r;
+  struct kcpu *k;
 
   if(((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
     panic("kfree");
 
+  // Still mapped by another process?
+  int ref = __atomic_sub_fetch(&PGREF(pa), 1, __ATOMIC_ACQ_REL);
+  if(ref > 0)
+    return;
+  if(ref < 0)
+    panic("kfree: ref");
+
+#ifdef DEBUG
   // Fill with junk to catch dangling refs.
   memset(pa, 1, PGSIZE);
+#endif
 
   r = (struct run*)pa;
 
+  push_off();
+  k = &kcpus[cpuid()];
+  acquire(&k->lock);
+  r->next = k->freelist;
+  k->freelist = r;
+  k->nfree++;
+  // Keep a batch for the next kalloc()s and give the rest back.
+  if(k->nfree >= 2*KBATCH)
+    kdrain(k, KBATCH);
+  release(&k->lock);
+  pop_off();
+}
+
+// Add a free block of 2^k pages at r to the buddy lists.
+// Caller holds kmem.lock.
+static void
+buddy_push(struct run *r, int k)
+{
+  r->prev = 0;
+  r->next = kmem.freelist[k];
+  if(r->next)
+    r->next->prev = r;
+  kmem.freelist[k] = r;
+  kmem.order[PAGEIDX(r)] = k + 1;
+  kmem.nblocks[k]++;
+}
+
+// Take the free block of 2^k pages at r off the buddy lists.
+// Caller holds kmem.lock.
+static void
+buddy_remove(struct run *r, int k)
+{
+  if(r->prev)
+    r->prev->next = r->next;
+  else
+    kmem.freelist[k] = r->next;
+  if(r->next)
+    r->next->prev = r->prev;
+  kmem.order[PAGEIDX(r)] = 0;
+  kmem.nblocks[k]--;
+}
+
+// Free a block of 2^k pages, merging it with its buddy
+// for as long as the buddy is free.  Caller holds kmem.lock.
+static void
+buddy_free(struct run *r, int k)
+{
+  uint64 i = PAGEIDX(r), b;
+
+  kmem.nfree += 1UL << k;
+  for(; k < MAXORDER; k++){
+    b = i ^ (1UL << k);
+    if(b >= NPAGE || kmem.order[b] != k + 1)
+      break;
+    buddy_remove(PAGEADDR(b), k);
+    i &= ~(1UL << k);
+  }
+  buddy_push(PAGEADDR(i), k);
+}
+
+// Allocate a block of 2^k pages, splitting a larger block
+// if need be.  Returns 0 if none is free.  Caller holds
+// kmem.lock.
+static struct run *
+buddy_alloc(int k)
+{
+  struct run *r;
+  int j;
+
+  for(j = k; j <= MAXORDER && kmem.freelist[j] == 0; j++)
+    ;
+  if(j > MAXORDER)
+    return 0;
+  r = kmem.freelist[j];
+  buddy_remove(r, j);
+  // give back the upper halves we don't need.
+  while(j > k){
+    j--;
+    buddy_push(PAGEADDR(PAGEIDX(r) + (1UL << j)), j);
+  }
+  kmem.nfree -= 1UL << k;
+  return r;
+}
+
+// Return up to n pages from CPU k's list to the buddy
+// system.  Caller holds k->lock.
+static void
+kdrain(struct kcpu *k, int n)
+{
+  struct run *r;
+
   acquire(&kmem.lock);
-  r->next = kmem.freelist;
-  kmem.freelist = r;
-  kmem.nfree++;  // Phase 2: Track free pages
+  while(n-- > 0 && (r = k->freelist) != 0){
+    k->freelist = r->next;
+    k->nfree--;
+    buddy_free(r, 0);
+  }
+  release(&kmem.lock);
+}
+
+// Return every cached single page, on all CPUs and in the
+// zeroed pool, to the buddy system so that they can merge.
+static void
+kflush(void)
+{
+  struct kcpu *k;
+  struct run *r;
+
+  for(k = kcpus; k < &kcpus[NCPU]; k++){
+    acquire(&k->lock);
+    kdrain(k, k->nfree);
+    release(&k->lock);
+  }
+  acquire(&kzero.lock);
+  acquire(&kmem.lock);
+  while((r = kzero.freelist) != 0){
+    kzero.freelist = r->next;
+    kzero.nfree--;
+    buddy_free(r, 0);
+  }
   release(&kmem.lock);
+  release(&kzero.lock);
+}
+
+// Take a page off this CPU's list, refilling it from the
+// global pool or other CPUs as needed.  Counts an allocation
+// if count is set.
+static struct run *
+kget(int count)
+{
+  struct run *r;
+  struct kcpu *k;
+
+  push_off();
+  k = &kcpus[cpuid()];
+  acquire(&k->lock);
+  if(k->freelist == 0){
+    acquire(&kmem.lock);
+    for(int i = 0; i < KBATCH && (r = buddy_alloc(0)) != 0; i++){
+      r->next = k->freelist;
+      k->freelist = r;
+      k->nfree++;
+    }
+    release(&kmem.lock);
+  }
+  r = k->freelist;
+  if(r) {
+    k->freelist = r->next;
+    k->nfree--;   // Phase 2: Track free pages
+    k->nalloc += count;  // Phase 2: Track total allocations
+  }
+  release(&k->lock);
+  if(r == 0 && (r = ksteal(k)) != 0)
+    k->nalloc += count;
+  pop_off();
+  return r;
+}
+
+// Take a page from the pre-zeroed pool, or 0 if it is empty.
+static struct run *
+kzget(void)
+{
+  struct run *r;
+
+  acquire(&kzero.lock);
+  r = kzero.freelist;
+  if(r){
+    kzero.freelist = r->next;
+    kzero.nfree--;
+  }
+  release(&kzero.lock);
+  return r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -75,37 +296,219 @@ kalloc(void)
 {
   struct run *r;
 
+  for(;;){
+    if((r = kget(1)) != 0)
+      break;
+    if((r = kzget()) != 0){
+      push_off();
+      kcpus[cpuid()].nalloc++;
+      pop_off();
+      break;
+    }
+    // out of memory: swap out a sleeping process's page,
+    // if the caller is allowed to sleep.
+    if(myproc() == 0 || holdingspin() || swapout(0) < 0)
+      break;
+  }
+  if(r)
+    PGREF(r) = 1;
+#ifdef DEBUG
+  if(r)
+    memset((char*)r, 5, PGSIZE); // fill with junk
+#endif
+  return (void*)r;
+}
+
+// Allocate 2^order physically contiguous pages, aligned to
+// their size.  Returns 0 if no block that large is free.
+void *
+kalloc_order(int order)
+{
+  struct run *r;
+
+  if(order == 0)
+    return kalloc();
+  if(order < 0 || order > MAXORDER)
+    return 0;
+
   acquire(&kmem.lock);
-  r = kmem.freelist;
-  if(r) {
-    kmem.freelist = r->next;
-    kmem.nfree--;   // Phase 2: Track free pages
-    kmem.nalloc++;  // Phase 2: Track total allocations
+  r = buddy_alloc(order);
+  release(&kmem.lock);
+  if(r == 0){
+    // pages cached one at a time may be keeping blocks apart.
+    kflush();
+    acquire(&kmem.lock);
+    r = buddy_alloc(order);
+    release(&kmem.lock);
+  }
+  if(r == 0)
+    return 0;
+
+  PGREF(r) = 1;
+  push_off();
+  kcpus[cpuid()].nalloc++;
+  pop_off();
+#ifdef DEBUG
+  memset((char*)r, 5, PGSIZE << order); // fill with junk
+#endif
+  return (void*)r;
+}
+
+// Free a block returned by kalloc_order(order).
+void
+kfree_order(void *pa, int order)
+{
+  if(order == 0){
+    kfree(pa);
+    return;
   }
+  if(order < 0 || order > MAXORDER || (PAGEIDX(pa) & ((1UL << order) - 1)) != 0 ||
+     (char*)pa < end || (uint64)pa + (PGSIZE << order) > PHYSTOP)
+    panic("kfree_order");
+
+  int ref = __atomic_sub_fetch(&PGREF(pa), 1, __ATOMIC_ACQ_REL);
+  if(ref > 0)
+    return;
+  if(ref < 0)
+    panic("kfree_order: ref");
+
+#ifdef DEBUG
+  memset(pa, 1, PGSIZE << order);
+#endif
+
+  acquire(&kmem.lock);
+  buddy_free((struct run*)pa, order);
   release(&kmem.lock);
+}
 
-  if(r)
-    memset((char*)r, 5, PGSIZE); // fill with junk
+// Turn a block from kalloc_order(order) into 2^order pages
+// that can each be passed to kfree() on its own.
+void
+ksplit(void *pa, int order)
+{
+  if(krefcnt(pa) != 1)
+    panic("ksplit");
+  for(int i = 1; i < (1 << order); i++)
+    PGREF((char*)pa + i*PGSIZE) = 1;
+}
+
+// Allocate a zeroed page, from the pool idle CPUs fill
+// if it has one, so the caller need not clear it.
+void *
+kzalloc(void)
+{
+  struct run *r;
+
+  if((r = kzget()) != 0){
+    r->next = 0;   // the pool's link was the only non-zero word
+    PGREF(r) = 1;
+    push_off();
+    kcpus[cpuid()].nalloc++;
+    pop_off();
+    return (void*)r;
+  }
+  if((r = kalloc()) != 0)
+    memset((char*)r, 0, PGSIZE);
   return (void*)r;
 }
 
-// Phase 2: Get number of free pages
+// Add a reference to the allocated page pa.
+void
+kref(void *pa)
+{
+  __atomic_add_fetch(&PGREF(pa), 1, __ATOMIC_ACQ_REL);
+}
+
+// Return the number of references to the allocated page pa.
+int
+krefcnt(void *pa)
+{
+  return __atomic_load_n(&PGREF(pa), __ATOMIC_ACQUIRE);
+}
+
+// Zero one free page into the kzalloc() pool, if it is below
+// KZPOOL pages and memory is not short.  Called by idle CPUs.
+// Returns 1 if it added a page.
+int
+kzfill(void)
+{
+  struct run *r;
+
+  if(__atomic_load_n(&kzero.nfree, __ATOMIC_RELAXED) >= KZPOOL)
+    return 0;
+  if(__atomic_load_n(&kmem.nfree, __ATOMIC_RELAXED) < KZPOOL)
+    return 0;
+  if((r = kget(0)) == 0)
+    return 0;
+  memset((char*)r, 0, PGSIZE);
+  acquire(&kzero.lock);
+  r->next = kzero.freelist;
+  kzero.freelist = r;
+  kzero.nfree++;
+  release(&kzero.lock);
+  return 1;
+}
+
+// The global pool is empty: take a page from another
+// CPU's list before giving up.  Called with interrupts off.
+static struct run *
+ksteal(struct kcpu *self)
+{
+  struct kcpu *k;
+  struct run *r = 0;
+
+  for(k = kcpus; k < &kcpus[NCPU] && r == 0; k++){
+    if(k == self)
+      continue;
+    acquire(&k->lock);
+    r = k->freelist;
+    if(r){
+      k->freelist = r->next;
+      k->nfree--;
+    }
+    release(&k->lock);
+  }
+  return r;
+}
+
+// Phase 2: Get number of free pages.  The per-CPU counts
+// are summed here rather than kept in one shared counter,
+// so the result may be off by pages in flight on other CPUs.
 uint64
 getfreepages(void)
 {
   uint64 n;
+
   acquire(&kmem.lock);
   n = kmem.nfree;
   release(&kmem.lock);
+  n += __atomic_load_n(&kzero.nfree, __ATOMIC_RELAXED);
+  for(int i = 0; i < NCPU; i++)
+    n += __atomic_load_n(&kcpus[i].nfree, __ATOMIC_RELAXED);
   return n;
 }
 
-// Phase 2: Get memory statistics
+// Phase 2: Get memory statistics.  If freeblocks is not 0,
+// also fill freeblocks[0..MAXORDER] with the number of free
+// blocks of each order, counting pages cached by CPUs as
+// single pages.
 void
-getmemstat(uint64 *freepages, uint64 *totalalloc)
+getmemstat(uint64 *freepages, uint64 *totalalloc, uint64 *freeblocks)
 {
-  acquire(&kmem.lock);
-  *freepages = kmem.nfree;
-  *totalalloc = kmem.nalloc;
-  release(&kmem.lock);
+  uint64 n = 0;
+
+  for(int i = 0; i < NCPU; i++)
+    n += __atomic_load_n(&kcpus[i].nalloc, __ATOMIC_RELAXED);
+  *freepages = getfreepages();
+  *totalalloc = n;
+
+  if(freeblocks){
+    acquire(&kmem.lock);
+    for(int k = 0; k <= MAXORDER; k++)
+      freeblocks[k] = kmem.nblocks[k];
+    release(&kmem.lock);
+    freeblocks[0] += __atomic_load_n(&kzero.nfree, __ATOMIC_RELAXED);
+    for(int i = 0; i < NCPU; i++)
+      freeblocks[0] += __atomic_load_n(&kcpus[i].nfree, __ATOMIC_RELAXED);
+  }
 }
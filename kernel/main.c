@@ -17,6 +17,7 @@ main()
     printf("xv6 kernel is booting\n");
     printf("\n");
     kinit();         // physical page allocator
+    slabinit();      // kernel object caches
     kvminit();       // create kernel page table
     kvminithart();   // turn on paging
     procinit();      // process table
@@ -27,8 +28,11 @@ main()
     binit();         // buffer cache
     iinit();         // inode table
     fileinit();      // file table
+    pipeinit();      // pipe cache
+    mmapinit();      // shared file pages
     virtio_disk_init(); // emulated hard disk
     userinit();      // first user process
+    randtest();      // check the scheduling PRNG
     __sync_synchronize();
     started = 1;
   } else {
@@ -41,5 +45,6 @@ main()
     plicinithart();   // ask PLIC for device interrupts
   }
 
+  randinithart();     // seed this CPU's scheduling PRNG
   scheduler();        
 }
@@ -0,0 +1,21 @@
+// Per-process memory usage, for getminfo().
+// Both the kernel and user programs use this header file.
+// Counts are in pages.
+struct minfo {
+  int pid;
+  int state;          // enum procstate in kernel/proc.h
+  uint64 sz;          // bytes of heap, touched or not
+  uint rss;           // resident user pages, shared ones included
+  uint peak;          // highest rss since fork() or exec()
+  uint ptpages;       // page-table pages
+  uint swapped;       // pages out in swap
+  uint faults;        // page-fault traps
+  uint majfaults;     // faults that read a page from disk
+  uint limit;         // most rss + swapped allowed, 0 for no limit
+  int group;          // memory group, or -1
+  char name[16];
+};
+
+// Exit status of a process killed by a page fault that would
+// have put it over its memory limit.
+#define EXIT_MEMLIMIT (-2)
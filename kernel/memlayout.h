@@ -57,3 +57,12 @@
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+
+#ifdef KPGTBL
+// with KPGTBL, a process's kernel page table maps its user
+// memory in place of the devices below 1 GiB, so the heap
+// must end below the first device the kernel uses, and
+// mmap() regions start above them at UMIRRORTOP.
+#define UMIRROR PLIC
+#define UMIRRORTOP (1L << 30)
+#endif
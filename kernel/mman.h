@@ -0,0 +1,25 @@
+// Memory-mapping constants, for mmap() and madvise().
+// Both the kernel and user programs use this header file.
+
+// mmap() protection; PROT_WRITE implies PROT_READ.
+#define PROT_NONE   0
+#define PROT_READ   1
+#define PROT_WRITE  2
+#define PROT_EXEC   4
+
+// mmap() flags; MAP_SHARED or MAP_PRIVATE, optionally with MAP_ANON.
+#define MAP_SHARED  1   // stores reach the file, and forked children
+#define MAP_PRIVATE 2   // stores stay in this process
+#define MAP_ANON    4   // zero-filled memory, not a file; fd is ignored
+
+#define MAP_FAILED  ((void *) -1)
+
+// madvise() advice.  The fault-around and huge page settings
+// apply to the whole process; addr and len are ignored.
+#define MADV_NORMAL      0  // default fault-around window
+#define MADV_RANDOM      1  // map only the faulting page
+#define MADV_SEQUENTIAL  2  // widest fault-around window
+#define MADV_WILLNEED    3  // map the range now
+#define MADV_DONTNEED    4  // free the range; it reads as zeros again
+#define MADV_HUGEPAGE    5  // use 2 MiB megapages when possible (default)
+#define MADV_NOHUGEPAGE  6  // only 4 KiB pages
@@ -0,0 +1,507 @@
+// Memory-mapped files and anonymous memory.
+//
+// mmap() records a region in a free slot of p->vma, placed
+// top-down below the trapframe, and maps nothing.  Pages are
+// read from the file through the buffer cache on first touch by
+// vmafault(), which vmfault() calls for addresses above p->sz.
+//
+// MAP_SHARED|MAP_ANON regions are the exception: their zeroed
+// pages are all mapped by mmap(), so that a child forked later
+// shares every page with its parent.  Pages are reference
+// counted, and the last process to unmap one frees it.
+//
+// A MAP_SHARED file page is kept in fpages, one physical page
+// per (inode, offset), however many processes map it, so they
+// all see each other's stores.  readi() and writei() read and
+// update that page in place of the buffer cache's copy, which
+// keeps read() and write() coherent with the mappings.  The
+// table holds a reference to each page, and drops the page once
+// the last mapping of it goes.
+//
+// A page is mapped without PTE_W until the first store to it,
+// so in a MAP_SHARED region PTE_W also means dirty; munmap(),
+// exit and exec write such pages back to the file through the
+// log.  fork() shares MAP_SHARED pages with the child and makes
+// writable MAP_PRIVATE pages copy-on-write.
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "stat.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "mman.h"
+
+struct {
+  struct spinlock lock;
+  struct fpage {
+    struct inode *ip;     // 0 if free
+    uint off;             // page-aligned file offset
+    uint64 pa;
+  } pg[NFPAGE];
+} fpages;
+
+void
+mmapinit(void)
+{
+  initlock(&fpages.lock, "fpages");
+}
+
+// Caller must hold fpages.lock.
+static struct fpage*
+fpagefind(struct inode *ip, uint off)
+{
+  struct fpage *fp;
+
+  off = PGROUNDDOWN(off);
+  for(fp = fpages.pg; fp < &fpages.pg[NFPAGE]; fp++)
+    if(fp->ip == ip && fp->off == off)
+      return fp;
+  return 0;
+}
+
+// The shared page holding byte off of ip, with a reference for
+// the caller to drop with fpageput(), or 0 if none is mapped.
+// Caller must hold ip->lock.
+uint64
+fpageget(struct inode *ip, uint off)
+{
+  struct fpage *fp;
+  uint64 pa = 0;
+
+  // only fpageadd(), under ip->lock, makes nfpage non-zero.
+  if(ip->nfpage == 0)
+    return 0;
+  acquire(&fpages.lock);
+  if((fp = fpagefind(ip, off)) != 0){
+    pa = fp->pa;
+    kref((void*)pa);
+  }
+  release(&fpages.lock);
+  return pa;
+}
+
+// Enter the page pa, just read from ip at off and holding the
+// caller's reference, as the shared copy.  Caller must hold
+// ip->lock.  Returns pa, or 0 if the table is full.
+static uint64
+fpageadd(struct inode *ip, uint off, uint64 pa)
+{
+  struct fpage *fp;
+
+  acquire(&fpages.lock);
+  for(fp = fpages.pg; fp < &fpages.pg[NFPAGE]; fp++){
+    if(fp->ip == 0){
+      fp->ip = ip;
+      fp->off = PGROUNDDOWN(off);
+      fp->pa = pa;
+      ip->nfpage++;
+      kref((void*)pa);
+      release(&fpages.lock);
+      return pa;
+    }
+  }
+  release(&fpages.lock);
+  return 0;
+}
+
+// Drop a reference to the shared page holding byte off of ip,
+// from fpageget() or an unmapped PTE, and forget the page once
+// only the table's own reference is left.
+void
+fpageput(struct inode *ip, uint off)
+{
+  struct fpage *fp;
+
+  acquire(&fpages.lock);
+  if((fp = fpagefind(ip, off)) == 0)
+    panic("fpageput");
+  kfree((void*)fp->pa);
+  if(krefcnt((void*)fp->pa) == 1){
+    kfree((void*)fp->pa);
+    ip->nfpage--;
+    fp->ip = 0;
+  }
+  release(&fpages.lock);
+}
+
+// Lowest address used by p's mappings, or UMIRROR
+// if lower.  The heap may not grow past it.
+uint64
+vmabase(struct proc *p)
+{
+  struct vma *v;
+  uint64 base = TRAPFRAME;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->len && v->addr < base)
+      base = v->addr;
+#ifdef KPGTBL
+  if(base > UMIRROR)
+    base = UMIRROR;
+#endif
+  return base;
+}
+
+static struct vma*
+vmalookup(struct proc *p, uint64 va)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->len && va >= v->addr && va < v->addr + v->len)
+      return v;
+  return 0;
+}
+
+// Find the highest free range of len bytes between the
+// heap and the trapframe.  Returns its start, or 0.
+static uint64
+vmaplace(struct proc *p, uint64 len)
+{
+  struct vma *v;
+  uint64 top = TRAPFRAME, floor = PGROUNDUP(p->sz);
+
+#ifdef KPGTBL
+  floor = UMIRRORTOP;
+#endif
+ again:
+  if(top < len || top - len < floor)
+    return 0;
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->len && v->addr < top && v->addr + v->len > top - len){
+      top = v->addr;
+      goto again;
+    }
+  }
+  return top - len;
+}
+
+// Map the page at va in v, reading it from the file, writable
+// only if write is set.  Returns its physical address, or 0.
+static uint64
+vmafill(struct proc *p, struct vma *v, uint64 va, int write)
+{
+  struct inode *ip = v->f ? v->f->ip : 0;
+  uint off = v->off + (va - v->addr);
+  int perm = PTE_U, shared = ip && (v->flags & MAP_SHARED);
+  char *mem;
+  uint64 pa = 0;
+
+  if(ip){
+    ilock(ip);
+    if(shared)
+      pa = fpageget(ip, off);
+    if(pa == 0 && (mem = kzalloc()) != 0){
+      // past the end of the file reads as zeros.
+      readi(ip, 0, (uint64)mem, off, PGSIZE);
+      p->majfaults++;
+      pa = (uint64)mem;
+      if(shared && fpageadd(ip, off, pa) == 0){
+        kfree(mem);
+        pa = 0;
+      }
+    }
+    iunlock(ip);
+  } else {
+    pa = (uint64)kzalloc();
+  }
+  if(pa == 0)
+    return 0;
+
+  if(v->prot & PROT_READ)
+    perm |= PTE_R;
+  if(v->prot & PROT_EXEC)
+    perm |= PTE_X;
+  if(write)
+    perm |= PTE_W;
+  if(mappages(p->pagetable, va, PGSIZE, pa, perm) != 0){
+    if(shared)
+      fpageput(ip, off);
+    else
+      kfree((void*)pa);
+    return 0;
+  }
+  return pa;
+}
+
+// Handle a fault at va, a load if read is set, otherwise a
+// store.  Maps the page, and like vmfault() reads ahead up to
+// p->faultaround - 1 more pages of the region.  Returns the
+// physical address, or 0 if va is not in a region that allows
+// the access.
+uint64
+vmafault(struct proc *p, uint64 va, int read)
+{
+  struct vma *v;
+  pte_t *pte;
+  uint64 pa, a;
+
+  va = PGROUNDDOWN(va);
+  if((v = vmalookup(p, va)) == 0 || (v->prot & (PROT_READ|PROT_EXEC)) == 0)
+    return 0;
+  if(!read && (v->prot & PROT_WRITE) == 0)
+    return 0;
+
+  pte = walk(p->pagetable, va, 0);
+  if(pte && (*pte & PTE_V)){
+    // first store to a page mapped by a load.
+    // copy-on-write pages are cowfault()'s.
+    if(read || (*pte & (PTE_W|PTE_COW)))
+      return 0;
+    *pte |= PTE_W;
+    uvmflush(p->pagetable, va, PGSIZE);
+    return PTE2PA(*pte);
+  }
+
+  // reading the file sleeps, which a caller holding a
+  // spinlock can't; it should ufault() and retry.
+  if(v->f && holdingspin())
+    return 0;
+  if(uvmlimit(p) == 0 || (pa = vmafill(p, v, va, !read)) == 0)
+    return 0;
+  // best effort: stop at the first mapped page, failure,
+  // or the memory limit.
+  for(a = va + PGSIZE; a < va + p->faultaround*PGSIZE && a < v->addr + v->len; a += PGSIZE){
+    if(uvmroom(p) <= 0 || ismapped(p->pagetable, a) || vmafill(p, v, a, 0) == 0)
+      break;
+  }
+  uvmflush(p->pagetable, va, a - va);
+  return pa;
+}
+
+// Write the page at va in v back to the file if v is
+// a shared file mapping and the page has been stored to.
+// Doesn't extend the file.
+static void
+vmasync(struct proc *p, struct vma *v, uint64 va)
+{
+  // a few blocks per transaction, as in filewrite().
+  int max = ((MAXOPBLOCKS-1-1-2) / 2) * BSIZE;
+  uint off = v->off + (va - v->addr);
+  struct inode *ip;
+  pte_t *pte;
+  int i, n, r;
+
+  if((v->flags & MAP_SHARED) == 0 || v->f == 0)
+    return;
+  ip = v->f->ip;
+  pte = walk(p->pagetable, va, 0);
+  if(pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_W) == 0)
+    return;
+
+  for(i = 0; i < PGSIZE; i += n){
+    begin_op();
+    ilock(ip);
+    n = 0;
+    if(off + i < ip->size){
+      n = PGSIZE - i;
+      if(n > max)
+        n = max;
+      if(off + i + n > ip->size)
+        n = ip->size - off - i;
+    }
+    r = n > 0 ? writei(ip, 0, PTE2PA(*pte) + i, off + i, n) : 0;
+    iunlock(ip);
+    end_op();
+    if(n == 0 || r != n)
+      break;
+  }
+}
+
+// Map len bytes of file f from offset off into the current
+// process, or zeroed memory if flags has MAP_ANON and f is 0.
+// Returns the address, or -1.
+uint64
+vmamap(struct file *f, uint64 len, int prot, int flags, uint off)
+{
+  struct proc *p = myproc();
+  struct vma *v, *free = 0;
+  uint64 addr, a;
+  int r, share = flags & ~MAP_ANON;
+
+  if(len == 0 || len > TRAPFRAME || off % PGSIZE != 0)
+    return -1;
+  if(share != MAP_SHARED && share != MAP_PRIVATE)
+    return -1;
+  if(prot & PROT_WRITE)
+    prot |= PROT_READ;
+  if(flags & MAP_ANON){
+    if(f != 0)
+      return -1;
+  } else {
+    if(f->type != FD_INODE || f->ip->type != T_FILE || !f->readable)
+      return -1;
+    if(share == MAP_SHARED && (prot & PROT_WRITE) && !f->writable)
+      return -1;
+  }
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->len == 0){
+      free = v;
+      break;
+    }
+  len = PGROUNDUP(len);
+  if(free == 0 || (addr = vmaplace(p, len)) == 0)
+    return -1;
+
+  free->addr = addr;
+  free->len = len;
+  free->prot = prot;
+  free->flags = flags;
+  free->off = off;
+  free->f = f ? filedup(f) : 0;
+
+  if(flags == (MAP_SHARED|MAP_ANON) && (prot & (PROT_READ|PROT_EXEC))){
+    // room is negative once a process is over its limit.
+    if((r = uvmroom(p)) <= 0 || len / PGSIZE > r){
+      vmaunmap(p, addr, len);   // over the memory limit
+      return -1;
+    }
+    for(a = addr; a < addr + len; a += PGSIZE){
+      if(vmafill(p, free, a, prot & PROT_WRITE) == 0){
+        vmaunmap(p, addr, len);
+        return -1;
+      }
+    }
+  }
+  return addr;
+}
+
+// Unmap [addr, addr+len) from p, writing back shared pages.
+// Regions partly inside the range are trimmed, or split if the
+// range is in the middle.  Returns 0, or -1 for bad arguments
+// or if a split needs a free vma slot and there isn't one.
+int
+vmaunmap(struct proc *p, uint64 addr, uint64 len)
+{
+  struct vma *v, *w;
+  uint64 lo, hi, end, vend, a;
+
+  if(addr % PGSIZE != 0 || len == 0 || addr + len < addr)
+    return -1;
+  end = PGROUNDUP(addr + len);
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++){
+    if(v->len == 0)
+      continue;
+    vend = v->addr + v->len;
+    lo = addr > v->addr ? addr : v->addr;
+    hi = end < vend ? end : vend;
+    if(lo >= hi)
+      continue;
+
+    w = 0;
+    if(lo > v->addr && hi < vend){
+      for(w = p->vma; w < &p->vma[NVMA] && w->len; w++)
+        ;
+      if(w == &p->vma[NVMA])
+        return -1;
+    }
+
+    for(a = lo; a < hi; a += PGSIZE)
+      vmasync(p, v, a);
+    if(v->f && (v->flags & MAP_SHARED)){
+      // shared file pages go back through the table.
+      for(a = lo; a < hi; a += PGSIZE){
+        if(!ismapped(p->pagetable, a))
+          continue;
+        uvmunmap(p->pagetable, a, 1, 0);
+        fpageput(v->f->ip, v->off + (a - v->addr));
+      }
+    } else {
+      uvmunmap(p->pagetable, lo, (hi - lo) / PGSIZE, 1);
+    }
+
+    if(lo == v->addr && hi == vend){
+      if(v->f)
+        fileclose(v->f);
+      v->f = 0;
+      v->len = 0;
+    } else if(lo == v->addr){
+      v->off += hi - v->addr;
+      v->len = vend - hi;
+      v->addr = hi;
+    } else if(hi == vend){
+      v->len = lo - v->addr;
+    } else {
+      *w = *v;
+      w->addr = hi;
+      w->len = vend - hi;
+      w->off = v->off + (hi - v->addr);
+      if(w->f)
+        filedup(w->f);
+      v->len = lo - v->addr;
+    }
+  }
+  return 0;
+}
+
+// Unmap all of p's regions, for exit and exec.
+void
+vmafree(struct proc *p)
+{
+  struct vma *v;
+
+  for(v = p->vma; v < &p->vma[NVMA]; v++)
+    if(v->len)
+      vmaunmap(p, v->addr, v->len);
+}
+
+// Give child np a copy of p's regions for fork().
+// Returns 0, or -1 if out of memory.  The caller holds
+// np->lock, so this must not sleep.
+int
+vmacopy(struct proc *p, struct proc *np)
+{
+  struct vma *v;
+  uint64 a, pa;
+  pte_t *pte;
+  int i;
+
+  for(i = 0; i < NVMA; i++){
+    v = &p->vma[i];
+    if(v->len == 0)
+      continue;
+    np->vma[i] = *v;
+    if(v->f)
+      filedup(v->f);
+    for(a = v->addr; a < v->addr + v->len; a += PGSIZE){
+      if((pte = walk(p->pagetable, a, 0)) == 0 || (*pte & PTE_V) == 0)
+        continue;
+      // a page not yet stored to may be upgraded in place by
+      // vmafault(), so all of a private writable region's
+      // pages become copy-on-write.
+      if((v->flags & MAP_PRIVATE) && (v->prot & PROT_WRITE))
+        *pte = (*pte & ~PTE_W) | PTE_COW;
+      pa = PTE2PA(*pte);
+      kref((void*)pa);
+      if(mappages(np->pagetable, a, PGSIZE, pa, PTE_FLAGS(*pte)) != 0){
+        kfree((void*)pa);
+        goto err;
+      }
+    }
+  }
+  uvmflush(p->pagetable, 0, MAXVA);
+  return 0;
+
+ err:
+  // p still holds every page and file, so nothing needs
+  // writing back and fileclose() won't sleep in iput().
+  for(v = np->vma; v < &np->vma[NVMA]; v++){
+    if(v->len == 0)
+      continue;
+    uvmunmap(np->pagetable, v->addr, v->len / PGSIZE, 1);
+    if(v->f)
+      fileclose(v->f);
+    v->f = 0;
+    v->len = 0;
+  }
+  uvmflush(p->pagetable, 0, MAXVA);
+  return -1;
+}
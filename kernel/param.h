@@ -1,15 +1,34 @@
 #define NPROC        64  // maximum number of processes
 #define NCPU          8  // maximum number of CPUs
+#define KBATCH       32  // pages moved between per-CPU and global free lists
+#define KZPOOL      256  // pre-zeroed pages idle CPUs keep for kzalloc()
+#define MAXORDER     10  // largest kalloc_order() block is 2^MAXORDER pages
+#define FAULTAROUND  16  // pages mapped per lazy page fault
+#define FAULTMAX     64  // fault-around window under MADV_SEQUENTIAL
+#define NVMA         16  // mmap() regions per process
+#define NFPAGE      256  // MAP_SHARED file pages mapped at once
+#define NCURRENCY    16  // maximum number of ticket currencies
+#define NMEMCG       16  // maximum number of memory groups
 #define NOFILE       16  // open files per process
-#define NFILE       100  // open files per system
-#define NINODE       50  // maximum number of active i-nodes
+#define NFILE       100  // open files per system (soft limit)
+#define NINODE       50  // active i-nodes (soft limit)
+#define SOFTRESERVE 128  // free pages kept back from files/i-nodes past their soft limits
 #define NDEV         10  // maximum major device number
 #define ROOTDEV       1  // device number of file system root disk
 #define MAXARG       32  // max exec arguments
 #define MAXOPBLOCKS  10  // max # of blocks any FS op writes
 #define LOGBLOCKS    (MAXOPBLOCKS*3)  // max data blocks in on-disk log
-#define NBUF         (MAXOPBLOCKS*3)  // size of disk block cache
-#define FSSIZE       2000  // size of file system in blocks
+#define NBUF         (MAXOPBLOCKS*8)  // size of disk block cache
+#define NBUCKET      13  // buffer cache hash buckets (prime)
+#define FSSIZE       3000  // size of file system in blocks
+#define SWAPSIZE    16384  // blocks of swap space after the file system
 #define MAXPATH      128   // maximum file path name
 #define USERSTACK    1     // user stack pages
+#define TICK      1000000  // timer cycles per clock tick (~1/10 s)
+#define QUANTUM   TICK     // default scheduling quantum, in timer cycles
+#define QUANTUMMIN (QUANTUM/100)  // shortest settable quantum (~1 ms)
+#define QUANTUMMAX (QUANTUM*10)   // longest settable quantum (~1 s)
+#define IDLEMAX   (TICK*10)    // longest tickless idle sleep (~1 s)
+#define COMPMAX      16    // max compensation-ticket multiplier
+#define MAXTICKETS 10000   // most tickets settickets()/mkcurrency() give
 
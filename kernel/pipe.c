@@ -7,6 +7,7 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "uio.h"
 
 #define PIPESIZE 512
 
@@ -19,6 +20,14 @@ struct pipe {
   int writeopen;  // write fd is still open
 };
 
+static struct kmem_cache *pipecache;
+
+void
+pipeinit(void)
+{
+  pipecache = kmem_cache_create("pipe", sizeof(struct pipe));
+}
+
 int
 pipealloc(struct file **f0, struct file **f1)
 {
@@ -28,7 +37,7 @@ pipealloc(struct file **f0, struct file **f1)
   *f0 = *f1 = 0;
   if((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
     goto bad;
-  if((pi = (struct pipe*)kalloc()) == 0)
+  if((pi = (struct pipe*)kmem_cache_alloc(pipecache)) == 0)
     goto bad;
   pi->readopen = 1;
   pi->writeopen = 1;
@@ -47,7 +56,7 @@ pipealloc(struct file **f0, struct file **f1)
 
  bad:
   if(pi)
-    kfree((char*)pi);
+    kmem_cache_free(pipecache, pi);
   if(*f0)
     fileclose(*f0);
   if(*f1)
@@ -68,17 +77,34 @@ pipeclose(struct pipe *pi, int writable)
   }
   if(pi->readopen == 0 && pi->writeopen == 0){
     release(&pi->lock);
-    kfree((char*)pi);
+    kmem_cache_free(pipecache, pi);
   } else
     release(&pi->lock);
 }
 
+// Number of bytes that can be copied at once between the
+// ring at index off and a buffer: at most n, and not past
+// the end of the ring or over the count bytes available.
+static int
+pipespan(uint off, uint count, int n)
+{
+  int m = PIPESIZE - off % PIPESIZE;
+
+  if(m > count)
+    m = count;
+  if(m > n)
+    m = n;
+  return m;
+}
+
 int
 pipewrite(struct pipe *pi, uint64 addr, int n)
 {
-  int i = 0;
+  int i = 0, m, r;
   struct proc *pr = myproc();
+  struct ucursor uc;
 
+  uinit(&uc, pr->pagetable);
   acquire(&pi->lock);
   while(i < n){
     if(pi->readopen == 0 || killed(pr)){
@@ -88,12 +114,22 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
     if(pi->nwrite == pi->nread + PIPESIZE){ //DOC: pipewrite-full
       wakeup(&pi->nread);
       sleep(&pi->nwrite, &pi->lock);
+      uinit(&uc, pr->pagetable);
     } else {
-      char ch;
-      if(copyin(pr->pagetable, &ch, addr + i, 1) == -1)
-        break;
-      pi->data[pi->nwrite++ % PIPESIZE] = ch;
-      i++;
+      m = pipespan(pi->nwrite, pi->nread + PIPESIZE - pi->nwrite, n - i);
+      if(ucopyin(&uc, &pi->data[pi->nwrite % PIPESIZE], addr + i, m) == -1){
+        // the page may need a fault that sleeps; take
+        // it without the pipe lock, then try again.
+        release(&pi->lock);
+        r = ufault(pr->pagetable, addr + i, m, 0);
+        acquire(&pi->lock);
+        if(r < 0)
+          break;
+        uinit(&uc, pr->pagetable);
+        continue;
+      }
+      pi->nwrite += m;
+      i += m;
     }
   }
   wakeup(&pi->nread);
@@ -105,9 +141,9 @@ pipewrite(struct pipe *pi, uint64 addr, int n)
 int
 piperead(struct pipe *pi, uint64 addr, int n)
 {
-  int i;
+  int i, m, r;
   struct proc *pr = myproc();
-  char ch;
+  struct ucursor uc;
 
   acquire(&pi->lock);
   while(pi->nread == pi->nwrite && pi->writeopen){  //DOC: pipe-empty
@@ -117,16 +153,25 @@ piperead(struct pipe *pi, uint64 addr, int n)
     }
     sleep(&pi->nread, &pi->lock); //DOC: piperead-sleep
   }
-  for(i = 0; i < n; i++){  //DOC: piperead-copy
-    if(pi->nread == pi->nwrite)
-      break;
-    ch = pi->data[pi->nread % PIPESIZE];
-    if(copyout(pr->pagetable, addr + i, &ch, 1) == -1) {
+  uinit(&uc, pr->pagetable);
+  for(i = 0; i < n && pi->nread != pi->nwrite; i += m){  //DOC: piperead-copy
+    m = pipespan(pi->nread, pi->nwrite - pi->nread, n - i);
+    if(ucopyout(&uc, addr + i, &pi->data[pi->nread % PIPESIZE], m) == -1) {
+      // as in pipewrite(); the data stays in the pipe
+      // while the lock is released.
+      release(&pi->lock);
+      r = ufault(pr->pagetable, addr + i, m, 1);
+      acquire(&pi->lock);
+      if(r == 0){
+        uinit(&uc, pr->pagetable);
+        m = 0;
+        continue;
+      }
       if(i == 0)
         i = -1;
       break;
     }
-    pi->nread++;
+    pi->nread += m;
   }
   wakeup(&pi->nwrite);  //DOC: piperead-wakeup
   release(&pi->lock);
@@ -4,22 +4,72 @@
 #include "riscv.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sched.h"
+#include "meminfo.h"
 #include "defs.h"
 
-// Simple random number generator
-unsigned long rand_state = 1;
-int
-random(void) {
-  rand_state = rand_state * 1664525 + 1013904223;
-  return rand_state;
-}
-
 struct cpu cpus[NCPU];
 
 struct proc proc[NPROC];
 
 struct proc *initproc;
 
+// Per-CPU run queues.  A Fenwick (binary indexed) tree over
+// the slots of proc[] holds the tickets of every RUNNABLE
+// process placed on that CPU, so the ticket total is at hand and
+// a lottery draw costs O(log NPROC).  A min-tree over the same
+// slots tracks the RUNNABLE process with the lowest stride pass,
+// so stride selection is O(log NPROC) too; both are kept up to
+// date so the policy can be switched at any time.  Each CPU picks
+// from its own queue and steals from the richest other queue when
+// its own is empty.  A runq's lock nests inside p->lock.
+struct runq {
+  struct spinlock lock;
+  int online;              // this CPU has entered scheduler()
+  int total;               // sum of tickets in the tree
+  int tree[NPROC+1];       // 1-based Fenwick tree
+  int minp[2*NPROC];       // min-pass tree; leaves at NPROC+slot, -1 if empty
+  uint64 pass;             // pass of the last stride pick
+} runqs[NCPU];
+
+static int runq_top;       // largest power of two <= NPROC
+
+int schedpolicy = SCHEDPOLICY;
+
+// A process's stride pass advances by STRIDE1/tickets per
+// full quantum, and proportionally less for a partial one.
+#define STRIDE1 (1 << 20)
+
+// Ticket currencies, after the lottery scheduling paper.
+// A currency is funded with a fixed number of tickets of its
+// parent currency (0 means base tickets) and issues its own
+// tickets to its members.  A member is worth its fraction of
+// the currency's active tickets, so a group's total share stays
+// capped however many children it forks.  Children inherit
+// their parent's currency.  currencies.lock nests inside p->lock.
+struct currency {
+  int ref;                 // members and child currencies; 0 if free
+  int funding;             // tickets held in the parent currency
+  int active;              // tickets of RUNNABLE or RUNNING members
+  struct currency *parent; // 0 for currencies funded in base tickets
+};
+
+struct {
+  struct spinlock lock;
+  struct currency cu[NCURRENCY];
+} currencies;
+
+// Memory groups, loosely after cgroups: a page limit shared by
+// every process in the group.  Members charge and uncharge
+// their pages with atomic adds in vm.c, so page faults never
+// take memgroups.lock, which only guards ref.  A process can't
+// leave its group, so its children can't either.
+// memgroups.lock nests inside p->lock.
+struct {
+  struct spinlock lock;
+  struct memcg cg[NMEMCG];
+} memgroups;
+
 int nextpid = 1;
 struct spinlock pid_lock;
 
@@ -28,12 +78,435 @@ static void freeproc(struct proc *p);
 
 extern char trampoline[]; // trampoline.S
 
+// One step of xorshift64*, a small generator with full 64-bit
+// period and good statistical quality in its high bits.
+static uint64
+xorshift64s(uint64 *state)
+{
+  uint64 x = *state;
+
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1DUL;
+}
+
+// Seed this CPU's scheduling PRNG.  The hart id is mixed in
+// so harts that boot in the same timer tick still diverge.
+void
+randinithart(void)
+{
+  uint64 seed = r_time() ^ ((cpuid() + 1) * 0x9E3779B97F4A7C15UL);
+
+  mycpu()->rand = seed ? seed : 1;
+}
+
+// Draw from this CPU's PRNG.  Each CPU has its own state,
+// so draws need no lock and don't share a cache line.
+// Interrupts must be disabled.
+static uint
+random(void)
+{
+  return xorshift64s(&mycpu()->rand) >> 32;
+}
+
+// Boot-time self-test of the draw distribution: a chi-square
+// test of 16000 fixed-seed draws over 16 buckets, the same
+// "random() % total" reduction the lottery uses.
+void
+randtest(void)
+{
+  int nbucket = 16, ndraw = 16000;
+  int count[16];
+  uint64 state = 1;
+  uint64 chi2 = 0;
+
+  memset(count, 0, sizeof(count));
+  for(int i = 0; i < ndraw; i++)
+    count[(uint)(xorshift64s(&state) >> 32) % nbucket]++;
+
+  // expect ndraw/nbucket per bucket; 15 degrees of freedom,
+  // so chi2 > 60 would happen by chance well under 1 in 10^6.
+  for(int i = 0; i < nbucket; i++){
+    int d = count[i] - ndraw/nbucket;
+    chi2 += d * d;
+  }
+  chi2 /= ndraw/nbucket;
+  if(chi2 > 60){
+    printf("randtest: chi2 %ld over 16 buckets\n", chi2);
+    panic("randtest");
+  }
+}
+
+// Add delta tickets to proc[] slot i.
+// Caller must hold q->lock.
+static void
+runq_update(struct runq *q, int i, int delta)
+{
+  q->total += delta;
+  for(i++; i <= NPROC; i += i & -i)
+    q->tree[i] += delta;
+}
+
+// Return the proc[] slot holding ticket number t,
+// 0 <= t < q->total.
+// Caller must hold q->lock.
+static int
+runq_find(struct runq *q, int t)
+{
+  int i = 0;
+
+  for(int step = runq_top; step > 0; step >>= 1){
+    if(i + step <= NPROC && q->tree[i + step] <= t){
+      i += step;
+      t -= q->tree[i];
+    }
+  }
+  return i;
+}
+
+// Of two min-tree entries, return the one with the lower pass.
+static int
+minpass(int a, int b)
+{
+  if(a < 0)
+    return b;
+  if(b < 0)
+    return a;
+  return proc[b].pass < proc[a].pass ? b : a;
+}
+
+// Put proc[] slot i into (slot >= 0) or take it out of (slot < 0)
+// the min-pass tree.
+// Caller must hold q->lock.
+static void
+runq_setpass(struct runq *q, int i, int slot)
+{
+  i += NPROC;
+  q->minp[i] = slot;
+  for(i >>= 1; i > 0; i >>= 1)
+    q->minp[i] = minpass(q->minp[2*i], q->minp[2*i+1]);
+}
+
+// Return the proc[] slot with the lowest pass in q, or -1.
+// Caller must hold q->lock.
+static int
+runq_minpass(struct runq *q)
+{
+  int m = -1;
+
+  for(int l = NPROC, r = 2*NPROC; l < r; l >>= 1, r >>= 1){
+    if(l & 1)
+      m = minpass(m, q->minp[l++]);
+    if(r & 1)
+      m = minpass(m, q->minp[--r]);
+  }
+  return m;
+}
+
+// Add delta to cu's active tickets.  A currency that gains its
+// first or loses its last active ticket in turn activates or
+// deactivates its funding in the parent currency.
+// Caller must hold currencies.lock.
+static void
+cu_activate(struct currency *cu, int delta)
+{
+  while(cu){
+    int was = cu->active;
+
+    cu->active += delta;
+    if(was == 0 && cu->active > 0)
+      delta = cu->funding;
+    else if(was > 0 && cu->active == 0)
+      delta = -cu->funding;
+    else
+      break;
+    cu = cu->parent;
+  }
+}
+
+// Drop a reference to cu, freeing it and releasing its
+// parent when the last member is gone.
+// Caller must hold currencies.lock.
+static void
+cu_put(struct currency *cu)
+{
+  while(cu && --cu->ref == 0)
+    cu = cu->parent;
+}
+
+// p's own tickets in base units: p->tickets converted through
+// each currency up the chain, but at least one.
+// Caller must hold p->lock.
+static int
+basetickets(struct proc *p)
+{
+  struct currency *cu;
+  uint64 v = p->tickets;
+
+  if(p->cu){
+    acquire(&currencies.lock);
+    for(cu = p->cu; cu; cu = cu->parent){
+      if(cu->active > 0)
+        v = v * cu->funding / cu->active;
+    }
+    release(&currencies.lock);
+  }
+  return v < 1 ? 1 : v;
+}
+
+// The weight p competes with: its own tickets plus any lent
+// to it by processes blocked on it.
+// Caller must hold p->lock.
+static int
+ptickets(struct proc *p)
+{
+  return basetickets(p) + p->borrowed;
+}
+
+// Move delta tickets from sleeping p to the process it lends to,
+// reweighting that process in place if it is queued.
+// Caller must hold p->lock; lendtickets() keeps lendees from
+// forming a loop, so taking t->lock as well can't deadlock.
+static void
+lend(struct proc *p, int delta)
+{
+  struct proc *t = p->lendee;
+  struct runq *q;
+
+  acquire(&t->lock);
+  if(t->pid != p->lendpid){
+    // lendee has exited; nothing to give or take back.
+    release(&t->lock);
+    p->lent = 0;
+    return;
+  }
+  t->borrowed += delta;
+  p->lent += delta;
+
+  // qtickets is only non-zero, and rq only valid, while t sits
+  // in a run queue; both change only under that queue's lock.
+  q = &runqs[t->rq];
+  acquire(&q->lock);
+  if(t->qtickets > 0 && t->rq == q - runqs){
+    if(t->qtickets + delta < 1)
+      delta = 1 - t->qtickets;
+    runq_update(q, t - proc, delta);
+    t->qtickets += delta;
+  }
+  release(&q->lock);
+  release(&t->lock);
+}
+
+// Pick the queue a newly RUNNABLE process should join:
+// the CPU it last ran on, to keep its cache warm, or else
+// the online, awake CPU with the fewest tickets queued.
+static struct runq*
+runq_place(struct proc *p)
+{
+  struct runq *q, *best;
+
+  // A tickless idle CPU won't look at its queue until some
+  // device interrupts it, so don't strand work there.
+  if(p->lastcpu >= 0 && !cpus[p->lastcpu].idle)
+    return &runqs[p->lastcpu];
+
+  best = &runqs[cpuid()];
+  for(q = runqs; q < &runqs[NCPU]; q++){
+    if(q->online && !cpus[q - runqs].idle && q->total < best->total)
+      best = q;
+  }
+  return best;
+}
+
+// Change p's state, entering or leaving a run queue
+// as p becomes or stops being RUNNABLE.
+// Caller must hold p->lock.
+static void
+setstate(struct proc *p, enum procstate state)
+{
+  struct runq *q;
+  int wasactive = p->state == RUNNABLE || p->state == RUNNING;
+  int active = state == RUNNABLE || state == RUNNING;
+  uint64 now = r_time();
+
+  // Accounting for getpinfo().
+  if(p->state == RUNNABLE)
+    p->waittime += now - p->statestart;
+  if(state == RUNNING)
+    p->picks++;
+  if(p->state == RUNNING){
+    p->runtime += now - p->statestart;
+    if(state == SLEEPING)
+      p->nvcsw++;
+    else if(state == RUNNABLE)
+      p->nivcsw++;
+  }
+  p->statestart = now;
+
+  // Measure the slice p just had, from scheduler()'s swtch
+  // to now, and charge a stride for it.
+  if(p->state == RUNNING && state != RUNNING){
+    p->slice = now - p->slicestart;
+    if(p->slice > QUANTUMMAX)
+      p->slice = QUANTUMMAX;
+    p->pass += (STRIDE1 / ptickets(p)) * p->slice / QUANTUM;
+
+    // An adaptive quantum grows for processes that keep being
+    // preempted, so batch jobs switch less, and shrinks for
+    // ones that block early, so they are quick to preempt.
+    if(p->adaptive){
+      if(state == RUNNABLE && p->slice >= p->quantum && p->quantum < QUANTUMMAX)
+        p->quantum *= 2;
+      else if(state == SLEEPING && p->quantum > QUANTUMMIN)
+        p->quantum /= 2;
+    }
+  }
+
+  // A process blocked in sleep() lends its tickets out.
+  if(p->lendee && state == SLEEPING)
+    lend(p, basetickets(p));
+  else if(p->lent && p->state == SLEEPING)
+    lend(p, -p->lent);
+
+  // Only RUNNABLE and RUNNING members share a currency's funding.
+  if(p->cu && wasactive != active){
+    acquire(&currencies.lock);
+    if(active){
+      p->cuactive = p->tickets;
+      cu_activate(p->cu, p->cuactive);
+    } else {
+      cu_activate(p->cu, -p->cuactive);
+      p->cuactive = 0;
+    }
+    release(&currencies.lock);
+  }
+
+  if(p->state != RUNNABLE && state == RUNNABLE){
+    q = runq_place(p);
+    acquire(&q->lock);
+    p->rq = q - runqs;
+    p->qtickets = ptickets(p);
+    if(p->state == SLEEPING){
+      // Compensation tickets: a process that blocked after
+      // using only a fraction f of its quantum competes with
+      // 1/f times its tickets until it next runs.
+      uint64 slice = p->slice;
+      if(slice < p->quantum/COMPMAX)
+        slice = p->quantum/COMPMAX;
+      if(slice > p->quantum)
+        slice = p->quantum;
+      p->qtickets = (uint64)p->qtickets * p->quantum / slice;
+    }
+    runq_update(q, p - proc, p->qtickets);
+    // Don't let a process bank pass while it sleeps.
+    if(p->pass < q->pass)
+      p->pass = q->pass;
+    runq_setpass(q, p - proc, p - proc);
+    release(&q->lock);
+
+    // q's CPU may have gone tickless-idle after runq_place()
+    // looked, and then won't see p until some device interrupts
+    // it.  It sets idle before checking runq_busy(), and we
+    // check idle after queueing p, so one of us sees the other;
+    // if we see it idle, move p here, where a CPU is awake.
+    __sync_synchronize();
+    if(cpus[p->rq].idle && p->rq != cpuid()){
+      acquire(&q->lock);
+      runq_update(q, p - proc, -p->qtickets);
+      runq_setpass(q, p - proc, -1);
+      release(&q->lock);
+      q = &runqs[cpuid()];
+      acquire(&q->lock);
+      p->rq = q - runqs;
+      runq_update(q, p - proc, p->qtickets);
+      if(p->pass < q->pass)
+        p->pass = q->pass;
+      runq_setpass(q, p - proc, p - proc);
+      release(&q->lock);
+    }
+  } else if(p->state == RUNNABLE && state != RUNNABLE){
+    q = &runqs[p->rq];
+    acquire(&q->lock);
+    runq_update(q, p - proc, -p->qtickets);
+    runq_setpass(q, p - proc, -1);
+    p->qtickets = 0;
+    release(&q->lock);
+  }
+  p->state = state;
+}
+
+// Pick the next process to run from run queue q: a lottery
+// winner, or the lowest pass under SCHED_STRIDE.
+// Returns the winner with p->lock held, still RUNNABLE,
+// or 0 if q is empty or another CPU took the winner first.
+static struct proc*
+runq_draw(struct runq *q)
+{
+  struct proc *p;
+
+  acquire(&q->lock);
+  if(q->total == 0){
+    release(&q->lock);
+    return 0;
+  }
+  if(schedpolicy == SCHED_STRIDE){
+    p = &proc[runq_minpass(q)];
+    q->pass = p->pass;
+  } else {
+    p = &proc[runq_find(q, random() % q->total)];
+  }
+  release(&q->lock);
+
+  acquire(&p->lock);
+  if(p->state != RUNNABLE){
+    release(&p->lock);
+    return 0;
+  }
+  return p;
+}
+
+// Steal work for an idle CPU: draw a ticket-weighted winner
+// from the queue holding the most tickets.  The totals are
+// read without locks; a stale read only costs a retry.
+static struct proc*
+runq_steal(struct runq *self)
+{
+  struct runq *q, *victim = 0;
+
+  for(q = runqs; q < &runqs[NCPU]; q++){
+    if(q != self && q->total > 0 && (victim == 0 || q->total > victim->total))
+      victim = q;
+  }
+  if(victim == 0)
+    return 0;
+  return runq_draw(victim);
+}
+
+// Is any process RUNNABLE on any CPU?
+static int
+runq_busy(void)
+{
+  struct runq *q;
+
+  for(q = runqs; q < &runqs[NCPU]; q++){
+    if(q->total > 0)
+      return 1;
+  }
+  return 0;
+}
+
 // helps ensure that wakeups of wait()ing
 // parents are not lost. helps obey the
 // memory model when using p->parent.
 // must be acquired before any p->lock.
 struct spinlock wait_lock;
 
+// serializes changes to p->lendee, so that
+// lendtickets() can refuse to close a loop.
+struct spinlock lend_lock;
+
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
 // guard page.
@@ -59,6 +532,16 @@ procinit(void)
   
   initlock(&pid_lock, "nextpid");
   initlock(&wait_lock, "wait_lock");
+  initlock(&lend_lock, "lend_lock");
+  initlock(&currencies.lock, "currencies");
+  initlock(&memgroups.lock, "memgroups");
+  for(int i = 0; i < NCPU; i++){
+    initlock(&runqs[i].lock, "runq");
+    for(int j = 0; j < 2*NPROC; j++)
+      runqs[i].minp[j] = -1;
+  }
+  for(runq_top = 1; runq_top * 2 <= NPROC; runq_top *= 2)
+    ;
   for(p = proc; p < &proc[NPROC]; p++) {
       initlock(&p->lock, "proc");
       p->state = UNUSED;
@@ -132,7 +615,23 @@ allocproc(void)
 found:
   p->pid = allocpid();
   p->tickets = 10; // Give every new process 10 tickets
-  p->state = USED;
+  p->runtime = 0;
+  p->waittime = 0;
+  p->picks = 0;
+  p->nvcsw = 0;
+  p->nivcsw = 0;
+  p->faults = 0;
+  p->majfaults = 0;
+  memset(&p->acct, 0, sizeof(p->acct));
+  p->faultaround = FAULTAROUND;
+  p->nohuge = 0;
+  p->pass = 0;
+  p->slice = QUANTUM;
+  p->quantum = QUANTUM;
+  p->adaptive = 0;
+  p->borrowed = 0;
+  p->lastcpu = -1;
+  setstate(p, USED);
 
   // Allocate a trapframe page.
   if((p->trapframe = (struct trapframe *)kalloc()) == 0){
@@ -143,7 +642,7 @@ found:
 
   // An empty user page table.
   p->pagetable = proc_pagetable(p);
-  if(p->pagetable == 0){
+  if(p->pagetable == 0 || kvmcreate(p) < 0){
     freeproc(p);
     release(&p->lock);
     return 0;
@@ -167,9 +666,16 @@ freeproc(struct proc *p)
   if(p->trapframe)
     kfree((void*)p->trapframe);
   p->trapframe = 0;
+  kvmfree(p);
   if(p->pagetable)
     proc_freepagetable(p->pagetable, p->sz);
   p->pagetable = 0;
+  if(p->acct.cg){
+    acquire(&memgroups.lock);
+    p->acct.cg->ref--;
+    release(&memgroups.lock);
+    p->acct.cg = 0;
+  }
   p->sz = 0;
   p->pid = 0;
   p->parent = 0;
@@ -177,7 +683,16 @@ freeproc(struct proc *p)
   p->chan = 0;
   p->killed = 0;
   p->xstate = 0;
-  p->state = UNUSED;
+  p->asid = 0;
+  p->lendee = 0;
+  p->lent = 0;
+  setstate(p, UNUSED);
+  if(p->cu){
+    acquire(&currencies.lock);
+    cu_put(p->cu);
+    release(&currencies.lock);
+    p->cu = 0;
+  }
 }
 
 // Create a user page table for a given process, with no user memory,
@@ -188,7 +703,7 @@ proc_pagetable(struct proc *p)
   pagetable_t pagetable;
 
   // An empty page table.
-  pagetable = uvmcreate();
+  pagetable = uvmcreate(p);
   if(pagetable == 0)
     return 0;
 
@@ -235,7 +750,7 @@ userinit(void)
   
   p->cwd = namei("/");
 
-  p->state = RUNNABLE;
+  setstate(p, RUNNABLE);
 
   release(&p->lock);
 }
@@ -246,15 +761,23 @@ int
 growproc(int n)
 {
   uint64 sz;
+  int r;
   struct proc *p = myproc();
 
   sz = p->sz;
   if(n > 0){
-    if(sz + n > TRAPFRAME) {
+    if(sz + n > vmabase(p)) {
       return -1;
     }
-    if((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0) {
-      return -1;
+    // room is negative once a process is over its limit.
+    r = uvmroom(p);
+    if(r <= 0 || (PGROUNDUP(sz + n) - PGROUNDUP(sz)) / PGSIZE > r) {
+      return -1;  // over the memory limit
+    }
+    while((sz = uvmalloc(p->pagetable, p->sz, p->sz + n, PTE_W)) == 0) {
+      // out of memory: swap pages out and try again.
+      if(swapreclaim(n / PGSIZE) < 0)
+        return -1;
     }
   } else if(n < 0){
     sz = uvmdealloc(p->pagetable, sz, sz + n);
@@ -272,11 +795,28 @@ kfork(void)
   struct proc *np;
   struct proc *p = myproc();
 
+  // Page-table pages for the child are allocated holding
+  // np->lock, which rules out swapping, so make room first:
+  // a level-0 page per 2 MiB, plus the trapframe and the
+  // page table's upper levels.
+  if(getfreepages() < p->sz/MEGAPGSIZE + 8)
+    swapreclaim(p->sz/MEGAPGSIZE + 8);
+
   // Allocate process.
   if((np = allocproc()) == 0){
     return -1;
   }
 
+  // The child is held to the parent's memory limits,
+  // which uvmcopy() checks.
+  np->acct.limit = p->acct.limit;
+  if(p->acct.cg){
+    acquire(&memgroups.lock);
+    p->acct.cg->ref++;
+    np->acct.cg = p->acct.cg;
+    release(&memgroups.lock);
+  }
+
   // Copy user memory from parent to child.
   if(uvmcopy(p->pagetable, np->pagetable, p->sz) < 0){
     freeproc(np);
@@ -284,7 +824,26 @@ kfork(void)
     return -1;
   }
   np->sz = p->sz;
+  np->guard = p->guard;
+  if(vmacopy(p, np) < 0){
+    freeproc(np);
+    release(&np->lock);
+    return -1;
+  }
   np->tickets = p->tickets;
+  np->pass = p->pass;
+  np->quantum = p->quantum;
+  np->faultaround = p->faultaround;
+  np->nohuge = p->nohuge;
+  np->adaptive = p->adaptive;
+  if(p->cu){
+    // The child spends the same currency, so the group's
+    // share doesn't grow with each fork.
+    acquire(&currencies.lock);
+    p->cu->ref++;
+    np->cu = p->cu;
+    release(&currencies.lock);
+  }
 
   // copy saved user registers.
   *(np->trapframe) = *(p->trapframe);
@@ -309,7 +868,7 @@ kfork(void)
   release(&wait_lock);
 
   acquire(&np->lock);
-  np->state = RUNNABLE;
+  setstate(np, RUNNABLE);
   release(&np->lock);
 
   return pid;
@@ -341,6 +900,9 @@ kexit(int status)
   if(p == initproc)
     panic("init exiting");
 
+  // Write back and unmap mmap() regions.
+  vmafree(p);
+
   // Close all open files.
   for(int fd = 0; fd < NOFILE; fd++){
     if(p->ofile[fd]){
@@ -366,7 +928,7 @@ kexit(int status)
   acquire(&p->lock);
 
   p->xstate = status;
-  p->state = ZOMBIE;
+  setstate(p, ZOMBIE);
 
   release(&wait_lock);
 
@@ -381,7 +943,7 @@ int
 kwait(uint64 addr)
 {
   struct proc *pp;
-  int havekids, pid;
+  int havekids, pid, retry;
   struct proc *p = myproc();
 
   acquire(&wait_lock);
@@ -389,6 +951,7 @@ kwait(uint64 addr)
   for(;;){
     // Scan through table looking for exited children.
     havekids = 0;
+    retry = 0;
     for(pp = proc; pp < &proc[NPROC]; pp++){
       if(pp->parent == p){
         // make sure the child isn't still in exit() or swtch().
@@ -400,9 +963,16 @@ kwait(uint64 addr)
           pid = pp->pid;
           if(addr != 0 && copyout(p->pagetable, addr, (char *)&pp->xstate,
                                   sizeof(pp->xstate)) < 0) {
+            // the page may need a fault that sleeps, as
+            // in pipewrite(); take it without the locks
+            // and look again.
             release(&pp->lock);
             release(&wait_lock);
-            return -1;
+            if(ufault(p->pagetable, addr, sizeof(pp->xstate), 1) < 0)
+              return -1;
+            acquire(&wait_lock);
+            retry = 1;
+            break;
           }
           freeproc(pp);
           release(&pp->lock);
@@ -412,6 +982,8 @@ kwait(uint64 addr)
         release(&pp->lock);
       }
     }
+    if(retry)
+      continue;
 
     // No point waiting if we don't have any children.
     if(!havekids || killed(p)){
@@ -427,64 +999,68 @@ kwait(uint64 addr)
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
+//  - pick a process from this CPU's run queue, by lottery
+//    or by stride, or steal one from the busiest other queue.
 //  - swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
-
-// Per-CPU process scheduler.
-
 void
 scheduler(void)
 {
   struct proc *p;
   struct cpu *c = mycpu();
+  struct runq *q = &runqs[cpuid()];
 
   c->proc = 0;
+  q->online = 1;
   for(;;){
-    // Enable interrupts on this processor.
+    // The most recent process to run may have had interrupts
+    // turned off; enable them to avoid a deadlock if all
+    // processes are waiting. Then turn them back off
+    // to avoid a possible race between an interrupt
+    // and wfi.
     intr_on();
-    intr_off(); // Briefly enable interrupts to avoid deadlock
-
-    int found = 0;
-    int total_tickets = 0;
-
-    // --- LOTTERY PART 1: Count total tickets ---
-    for(p = proc; p < &proc[NPROC]; p++) {
-      acquire(&p->lock);
-      if(p->state == RUNNABLE) {
-        total_tickets += p->tickets;
-      }
+    intr_off();
+
+    if((p = runq_draw(q)) != 0 || (q->total == 0 && (p = runq_steal(q)) != 0)){
+      // Switch to chosen process.  It is the process's job
+      // to release its lock and then reacquire it
+      // before jumping back to us.
+      setstate(p, RUNNING);
+      p->lastcpu = cpuid();
+      p->slicestart = r_time();
+      c->sliceend = p->slicestart + p->quantum;
+      timerset();
+      c->proc = p;
+      kvmswitch(p);
+      swtch(&c->context, &p->context);
+      // leave p's kernel page table before releasing p->lock,
+      // after which wait() may free it.
+      kvmswitch(0);
+
+      // Process is done running for now.
+      // It should have changed its p->state before coming back.
+      c->proc = 0;
+      c->sliceend = 0;
       release(&p->lock);
-    }
-
-    // --- LOTTERY PART 2: Pick a winner ---
-    if(total_tickets > 0) {
-      int winner = random() % total_tickets;
-      int counter = 0;
-
-      for(p = proc; p < &proc[NPROC]; p++) {
-        acquire(&p->lock);
-        if(p->state == RUNNABLE) {
-          counter += p->tickets;
-          if(counter > winner) {
-            // Process found! Run it.
-            p->state = RUNNING;
-            c->proc = p;
-            swtch(&c->context, &p->context);
-            c->proc = 0;
-            found = 1;
-            release(&p->lock);
-            break; // Stop searching, we found the winner
-          }
-        }
-        release(&p->lock);
+    } else if(!runq_busy()){
+      // nothing to run; zero a page for kzalloc() if the pool
+      // is low, then look again.
+      if(kzfill())
+        continue;
+
+      // stop running on this core until an interrupt.
+      // in tickless mode that means no timer interrupts either,
+      // and runq_place() stops handing this CPU work.
+      c->idle = 1;
+      __sync_synchronize();
+      if(runq_busy()){
+        c->idle = 0;
+        continue;
       }
-    }
-
-    if(found == 0) {
-      // nothing to run; stop running on this core until an interrupt.
+      timerset();
       asm volatile("wfi");
+      c->idle = 0;
     }
   }
 }
@@ -522,7 +1098,7 @@ yield(void)
 {
   struct proc *p = myproc();
   acquire(&p->lock);
-  p->state = RUNNABLE;
+  setstate(p, RUNNABLE);
   sched();
   release(&p->lock);
 }
@@ -559,7 +1135,7 @@ forkret(void)
 
   // return to user space, mimicing usertrap()'s return.
   prepare_return();
-  uint64 satp = MAKE_SATP(p->pagetable);
+  uint64 satp = uvmsatp(p);
   uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
   ((void (*)(uint64))trampoline_userret)(satp);
 }
@@ -583,7 +1159,7 @@ sleep(void *chan, struct spinlock *lk)
 
   // Go to sleep.
   p->chan = chan;
-  p->state = SLEEPING;
+  setstate(p, SLEEPING);
 
   sched();
 
@@ -606,13 +1182,191 @@ wakeup(void *chan)
     if(p != myproc()){
       acquire(&p->lock);
       if(p->state == SLEEPING && p->chan == chan) {
-        p->state = RUNNABLE;
+        setstate(p, RUNNABLE);
       }
       release(&p->lock);
     }
   }
 }
 
+// Switch scheduling policy to SCHED_LOTTERY or SCHED_STRIDE.
+// Every run queue tracks both tickets and passes, so this
+// takes effect at each CPU's next pick.
+// Returns the previous policy, or -1 if policy is unknown.
+int
+setsched(int policy)
+{
+  int old;
+
+  if(policy != SCHED_LOTTERY && policy != SCHED_STRIDE)
+    return -1;
+  old = schedpolicy;
+  schedpolicy = policy;
+  return old;
+}
+
+// Lend the caller's tickets to process pid whenever the caller
+// is blocked in sleep(), e.g. waiting on a pipe to pid.
+// pid 0 stops lending.  Returns 0, or -1 if there is no such pid
+// or pid already lends, directly or not, to the caller.
+int
+lendtickets(int pid)
+{
+  struct proc *p = myproc();
+  struct proc *t = 0, *u;
+  int n;
+
+  if(pid != 0){
+    for(t = proc; t < &proc[NPROC]; t++){
+      if(t == p)
+        continue;
+      acquire(&t->lock);
+      if(t->pid == pid && t->state != ZOMBIE){
+        release(&t->lock);
+        break;
+      }
+      release(&t->lock);
+    }
+    if(t == &proc[NPROC])
+      return -1;
+  }
+
+  // lend() holds the lender's lock while it takes the lendee's,
+  // so a loop of lenders asleep at once would deadlock.  Follow
+  // the slots t lends to, stale or not; freeproc() only ever
+  // clears a lendee, so under lend_lock the chain can't grow.
+  acquire(&lend_lock);
+  for(u = t, n = 0; u && u != p && n < NPROC; n++)
+    u = u->lendee;
+  if(u == p){
+    release(&lend_lock);
+    return -1;
+  }
+
+  // p is RUNNING, so it has nothing lent out right now.
+  acquire(&p->lock);
+  p->lendee = t;
+  p->lendpid = pid;
+  release(&p->lock);
+  release(&lend_lock);
+  return 0;
+}
+
+// Create a currency funded with funding tickets of the caller's
+// current currency, and move the caller into it; the caller's
+// own tickets and all future children's are then issued in it.
+// Returns the currency's id, or -1 if none are free or funding
+// is out of range.
+int
+mkcurrency(int funding)
+{
+  struct proc *p = myproc();
+  struct currency *cu;
+
+  if(funding < 1 || funding > MAXTICKETS)
+    return -1;
+
+  acquire(&p->lock);
+  acquire(&currencies.lock);
+  for(cu = currencies.cu; cu < &currencies.cu[NCURRENCY]; cu++){
+    if(cu->ref == 0)
+      break;
+  }
+  if(cu == &currencies.cu[NCURRENCY]){
+    release(&currencies.lock);
+    release(&p->lock);
+    return -1;
+  }
+  cu->ref = 1;
+  cu->funding = funding;
+  cu->active = 0;
+  cu->parent = p->cu;   // inherits p's reference to the old currency
+
+  // p is RUNNING: move its active tickets across.
+  if(p->cu)
+    cu_activate(p->cu, -p->cuactive);
+  p->cu = cu;
+  p->cuactive = p->tickets;
+  cu_activate(cu, p->cuactive);
+  release(&currencies.lock);
+  release(&p->lock);
+
+  return cu - currencies.cu;
+}
+
+// Limit the caller, and children it forks from now on, to
+// pages of resident and swapped-out memory.  Like a hard
+// rlimit, a limit once set can only be lowered, so a child
+// can't escape one it inherited.  Returns 0, or -1 if pages
+// isn't positive or would raise the limit.
+int
+setmemlimit(int pages)
+{
+  struct memacct *a = &myproc()->acct;
+
+  if(pages < 1 || (a->limit && pages > a->limit))
+    return -1;
+  a->limit = pages;
+  return 0;
+}
+
+// Create a memory group limited to pages, and move the caller
+// into it; its children will be members too.  Returns the
+// group's id, or -1 if the caller is already in a group or
+// none are free.
+int
+mkmemgroup(int pages)
+{
+  struct proc *p = myproc();
+  struct memcg *cg;
+
+  if(pages < 1 || p->acct.cg)
+    return -1;
+
+  acquire(&memgroups.lock);
+  for(cg = memgroups.cg; cg < &memgroups.cg[NMEMCG]; cg++){
+    if(cg->ref == 0)
+      break;
+  }
+  if(cg == &memgroups.cg[NMEMCG]){
+    release(&memgroups.lock);
+    return -1;
+  }
+  cg->ref = 1;
+  cg->limit = pages;
+  cg->charged = p->acct.rss + p->acct.swapped;
+  p->acct.cg = cg;
+  release(&memgroups.lock);
+
+  return cg - memgroups.cg;
+}
+
+// Set the caller's scheduling quantum to n timer cycles,
+// clamped to [QUANTUMMIN, QUANTUMMAX], or make it adaptive
+// if n is 0.  Children inherit the setting.
+// Returns 0, or -1 if n is negative.
+int
+setquantum(int n)
+{
+  struct proc *p = myproc();
+
+  if(n < 0)
+    return -1;
+  acquire(&p->lock);
+  if(n == 0){
+    p->adaptive = 1;
+  } else {
+    if(n < QUANTUMMIN)
+      n = QUANTUMMIN;
+    if(n > QUANTUMMAX)
+      n = QUANTUMMAX;
+    p->adaptive = 0;
+    p->quantum = n;
+  }
+  release(&p->lock);
+  return 0;
+}
+
 // Kill the process with the given pid.
 // The victim won't exit until it tries to return
 // to user space (see usertrap() in trap.c).
@@ -624,10 +1378,10 @@ kkill(int pid)
   for(p = proc; p < &proc[NPROC]; p++){
     acquire(&p->lock);
     if(p->pid == pid){
-      p->killed = 1;
+      p->killed = -1;
       if(p->state == SLEEPING){
         // Wake process from sleep().
-        p->state = RUNNABLE;
+        setstate(p, RUNNABLE);
       }
       release(&p->lock);
       return 0;
@@ -637,11 +1391,12 @@ kkill(int pid)
   return -1;
 }
 
+// Mark p killed; it will exit with status.
 void
-setkilled(struct proc *p)
+setkilled(struct proc *p, int status)
 {
   acquire(&p->lock);
-  p->killed = 1;
+  p->killed = status;
   release(&p->lock);
 }
 
@@ -686,6 +1441,85 @@ either_copyin(void *dst, int user_src, uint64 src, uint64 len)
   }
 }
 
+// Copy scheduling statistics for up to n live processes
+// to the user array at addr.  Returns the number copied,
+// or -1 on a bad address.
+int
+getpinfo(uint64 addr, int n)
+{
+  struct proc *p;
+  struct pinfo pi;
+  int i = 0;
+
+  for(p = proc; p < &proc[NPROC] && i < n; p++){
+    acquire(&p->lock);
+    if(p->state == UNUSED){
+      release(&p->lock);
+      continue;
+    }
+    pi.pid = p->pid;
+    pi.state = p->state;
+    pi.cpu = p->lastcpu;
+    pi.tickets = p->tickets;
+    pi.effective = p->state == RUNNABLE ? p->qtickets : ptickets(p);
+    pi.runtime = p->runtime;
+    pi.waittime = p->waittime;
+    // Count the time in the current state too.
+    if(p->state == RUNNING)
+      pi.runtime += r_time() - p->statestart;
+    else if(p->state == RUNNABLE)
+      pi.waittime += r_time() - p->statestart;
+    pi.picks = p->picks;
+    pi.nvcsw = p->nvcsw;
+    pi.nivcsw = p->nivcsw;
+    pi.faults = p->faults;
+    safestrcpy(pi.name, p->name, sizeof(pi.name));
+    release(&p->lock);
+
+    if(copyout(myproc()->pagetable, addr + i*sizeof(pi), (char*)&pi, sizeof(pi)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
+// Copy memory usage for up to n live processes to the user
+// array at addr.  Returns the number copied, or -1 on a bad
+// address.
+int
+getminfo(uint64 addr, int n)
+{
+  struct proc *p;
+  struct minfo mi;
+  int i = 0;
+
+  for(p = proc; p < &proc[NPROC] && i < n; p++){
+    acquire(&p->lock);
+    if(p->state == UNUSED){
+      release(&p->lock);
+      continue;
+    }
+    mi.pid = p->pid;
+    mi.state = p->state;
+    mi.sz = p->sz;
+    mi.rss = p->acct.rss;
+    mi.peak = p->acct.peak;
+    mi.ptpages = p->acct.ptpages;
+    mi.swapped = p->acct.swapped;
+    mi.faults = p->faults;
+    mi.majfaults = p->majfaults;
+    mi.limit = p->acct.limit;
+    mi.group = p->acct.cg ? p->acct.cg - memgroups.cg : -1;
+    safestrcpy(mi.name, p->name, sizeof(mi.name));
+    release(&p->lock);
+
+    if(copyout(myproc()->pagetable, addr + i*sizeof(mi), (char*)&mi, sizeof(mi)) < 0)
+      return -1;
+    i++;
+  }
+  return i;
+}
+
 // Print a process listing to console.  For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
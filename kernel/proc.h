@@ -24,6 +24,11 @@ struct cpu {
   struct context context;     // swtch() here to enter scheduler().
   int noff;                   // Depth of push_off() nesting.
   int intena;                 // Were interrupts enabled before push_off()?
+  uint64 rand;                // Scheduling PRNG state, never 0.
+  uint64 sliceend;            // r_time() when c->proc's quantum ends, 0 if none
+  int idle;                   // In wfi in the scheduler's idle loop
+  uint64 asidgen;             // Generation of the ASIDs being handed out
+  uint64 asidnext;            // Next ASID to hand out
 };
 
 extern struct cpu cpus[NCPU];
@@ -81,6 +86,37 @@ struct trapframe {
 
 enum procstate { UNUSED, USED, SLEEPING, RUNNABLE, RUNNING, ZOMBIE };
 
+// A region mapped by mmap(), filled in on demand by vmafault().
+struct vma {
+  uint64 addr;                 // Page-aligned start
+  uint64 len;                  // Bytes, a multiple of PGSIZE; 0 if unused
+  int prot;                    // PROT_ bits
+  int flags;                   // MAP_SHARED or MAP_PRIVATE, and MAP_ANON
+  struct file *f;              // File mapped, 0 for MAP_ANON
+  uint off;                    // File offset of addr
+};
+
+// A memory group: processes sharing one page limit, made by
+// mkmemgroup() and inherited across fork().
+struct memcg {
+  int ref;                     // Members; 0 if free, under memgroups.lock
+  int limit;                   // Pages the members may have charged
+  int charged;                 // rss + swapped of all members, atomic
+};
+
+// Pages charged to a process's user page table, kept up to
+// date by vm.c and swap.c.  Only the process itself updates
+// them, or another CPU while the process can't run: its
+// parent in fork(), or swapout() holding its p->lock.
+struct memacct {
+  int rss;                     // Resident user pages, a megapage counts 512
+  int peak;                    // Highest rss since fork() or exec()
+  int ptpages;                 // Page-table pages
+  int swapped;                 // Pages out in swap
+  int limit;                   // Most rss + swapped allowed, 0 for no limit
+  struct memcg *cg;            // Memory group charged as well, or 0
+};
+
 // Per-process state
 struct proc {
   struct spinlock lock;
@@ -88,9 +124,18 @@ struct proc {
   // p->lock must be held when using these:
   enum procstate state;        // Process state
   void *chan;                  // If non-zero, sleeping on chan
-  int killed;                  // If non-zero, have been killed
+  int killed;                  // If non-zero, killed, with this exit status
   int xstate;                  // Exit status to be returned to parent's wait
   int pid;                     // Process ID
+  int qtickets;                // Tickets this proc holds in the run queue
+  int rq;                      // Run queue (CPU) holding this proc if RUNNABLE
+  int lastcpu;                 // CPU this proc last ran on, or -1
+  uint64 statestart;           // r_time() of the last state change
+  uint64 runtime;              // Timer cycles spent RUNNING
+  uint64 waittime;             // Timer cycles spent RUNNABLE
+  uint picks;                  // Times the scheduler chose this proc
+  uint nvcsw;                  // Switches out by blocking
+  uint nivcsw;                 // Switches out by preemption
 
   // wait_lock must be held when using this:
   struct proc *parent;         // Parent process
@@ -99,10 +144,31 @@ struct proc {
   uint64 kstack;               // Virtual address of kernel stack
   uint64 sz;                   // Size of process memory (bytes)
   pagetable_t pagetable;       // User page table
+  pagetable_t kpagetable;      // Kernel page table mapping it, with KPGTBL
+  uint64 guard;                // Stack guard page below the user stack
+  uint64 asid;                 // ASID on CPU asidcpu, with its generation; 0 if none
+  int asidcpu;                 // CPU asid is from
   struct trapframe *trapframe; // data page for trampoline.S
   struct context context;      // swtch() here to run process
   struct file *ofile[NOFILE];  // Open files
   struct inode *cwd;           // Current directory
-  int tickets;
+  struct vma vma[NVMA];        // mmap() regions, above the heap
+  int faultaround;             // Pages mapped per lazy page fault
+  int nohuge;                  // Don't map heap with megapages
+  uint faults;                 // Page-fault traps taken
+  uint majfaults;              // Faults that read a page from disk
+  struct memacct acct;         // Memory charged to pagetable
+  int tickets;                 // Lottery tickets, also the stride weight
+  uint64 pass;                 // Stride pass value
+  uint64 slicestart;           // r_time() when last switched to
+  uint64 slice;                // Timer cycles used in last slice
+  uint64 quantum;              // Timer cycles per slice
+  int adaptive;                // Adjust quantum to how slices end
+  struct currency *cu;         // Currency tickets are issued in, 0 for base
+  int cuactive;                // Tickets counted as active in cu
+  int borrowed;                // Tickets lent to us by sleeping processes
+  struct proc *lendee;         // Process we lend our tickets to while asleep
+  int lendpid;                 // lendee's pid when lending began
+  int lent;                    // Tickets currently lent to lendee
   char name[16];               // Process name (debugging)
 };
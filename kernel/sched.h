@@ -0,0 +1,26 @@
+// Scheduling policies, for setsched().
+// Both the kernel and user programs use this header file.
+#define SCHED_LOTTERY 0   // randomized draw weighted by tickets
+#define SCHED_STRIDE  1   // deterministic lowest-pass-first
+
+// Per-process scheduling statistics, for getpinfo().
+// Times are in timer cycles (10 per microsecond under qemu).
+struct pinfo {
+  int pid;
+  int state;          // enum procstate in kernel/proc.h
+  int cpu;            // CPU it last ran on, or -1
+  int tickets;        // base tickets
+  int effective;      // tickets it currently competes with
+  uint64 runtime;     // time spent running
+  uint64 waittime;    // time spent runnable, waiting for a CPU
+  uint picks;         // times the scheduler chose it
+  uint nvcsw;         // voluntary switches (blocked)
+  uint nivcsw;        // involuntary switches (preempted)
+  uint faults;        // page-fault traps
+  char name[16];
+};
+
+// Policy the kernel boots with; override with make SCHED=stride.
+#ifndef SCHEDPOLICY
+#define SCHEDPOLICY SCHED_LOTTERY
+#endif
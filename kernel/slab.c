@@ -0,0 +1,254 @@
+// Slab allocator for small kernel objects.
+//
+// A cache hands out objects of one size, carved from slabs:
+// pages from kalloc(), each starting with a struct slab and
+// followed by the objects.  A slab's free objects are chained
+// through their first word.
+//
+// Each CPU keeps a magazine of up to MAGSIZE free objects per
+// cache, so most allocations and frees touch no shared state.
+// The cache lock is taken only to move MAGSIZE/2 objects between
+// a magazine and the slabs.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "slab.h"
+#include "defs.h"
+
+#define NCACHE  16   // maximum number of caches
+#define MAGSIZE 16   // objects per per-CPU magazine
+
+struct slab {
+  struct slab *next;        // on the cache's partial list
+  struct slab *prev;
+  struct kmem_cache *cache;
+  void *free;               // free objects in this slab
+  uint inuse;               // objects handed out of this slab
+};
+
+// Objects start after the header, 8-byte aligned.
+#define SLABHDR ((sizeof(struct slab) + 7) & ~7)
+
+struct magazine {
+  int n;
+  void *obj[MAGSIZE];
+  uint64 nalloc;            // allocations on this CPU
+};
+
+struct kmem_cache {
+  struct spinlock lock;
+  char name[16];
+  uint size;                // object size, rounded up to 8
+  uint perslab;             // objects per slab
+  struct slab *partial;     // slabs with free objects
+  uint nslabs;
+  uint inuse;               // objects out of slabs, incl. magazines
+  struct magazine mag[NCPU];
+};
+
+struct {
+  struct spinlock lock;
+  int n;
+  struct kmem_cache cache[NCACHE];
+} slabs;
+
+void
+slabinit(void)
+{
+  initlock(&slabs.lock, "slabs");
+}
+
+// Create a cache of objects of the given size.
+struct kmem_cache*
+kmem_cache_create(char *name, uint size)
+{
+  struct kmem_cache *c;
+
+  size = (size + 7) & ~7;
+  if(size < sizeof(void*) || size > PGSIZE - SLABHDR)
+    panic("kmem_cache_create: size");
+
+  acquire(&slabs.lock);
+  if(slabs.n >= NCACHE)
+    panic("kmem_cache_create: too many caches");
+  c = &slabs.cache[slabs.n++];
+  release(&slabs.lock);
+
+  initlock(&c->lock, "kmem_cache");
+  safestrcpy(c->name, name, sizeof(c->name));
+  c->size = size;
+  c->perslab = (PGSIZE - SLABHDR) / size;
+  return c;
+}
+
+static void
+partial_push(struct kmem_cache *c, struct slab *s)
+{
+  s->prev = 0;
+  s->next = c->partial;
+  if(s->next)
+    s->next->prev = s;
+  c->partial = s;
+}
+
+static void
+partial_remove(struct kmem_cache *c, struct slab *s)
+{
+  if(s->prev)
+    s->prev->next = s->next;
+  else
+    c->partial = s->next;
+  if(s->next)
+    s->next->prev = s->prev;
+}
+
+// Get a new slab page for c and put it on the partial list.
+// Returns 0 if out of memory.  Caller holds c->lock.
+static struct slab*
+slab_grow(struct kmem_cache *c)
+{
+  struct slab *s;
+  char *obj;
+
+  if((s = (struct slab*)kalloc()) == 0)
+    return 0;
+  s->cache = c;
+  s->inuse = 0;
+  s->free = 0;
+  for(int i = c->perslab - 1; i >= 0; i--){
+    obj = (char*)s + SLABHDR + i*c->size;
+    *(void**)obj = s->free;
+    s->free = obj;
+  }
+  partial_push(c, s);
+  c->nslabs++;
+  return s;
+}
+
+// Fill magazine m half way from c's slabs.
+static void
+slab_refill(struct kmem_cache *c, struct magazine *m)
+{
+  struct slab *s;
+  void *obj;
+
+  acquire(&c->lock);
+  while(m->n < MAGSIZE/2){
+    if((s = c->partial) == 0 && (s = slab_grow(c)) == 0)
+      break;
+    obj = s->free;
+    s->free = *(void**)obj;
+    s->inuse++;
+    c->inuse++;
+    if(s->free == 0)
+      partial_remove(c, s);
+    m->obj[m->n++] = obj;
+  }
+  release(&c->lock);
+}
+
+// Return n objects from magazine m to their slabs, freeing
+// slabs that become empty.
+static void
+slab_drain(struct kmem_cache *c, struct magazine *m, int n)
+{
+  struct slab *s;
+  void *obj;
+
+  acquire(&c->lock);
+  while(n-- > 0 && m->n > 0){
+    obj = m->obj[--m->n];
+    s = (struct slab*)PGROUNDDOWN((uint64)obj);
+    if(s->free == 0)
+      partial_push(c, s);   // was full
+    *(void**)obj = s->free;
+    s->free = obj;
+    s->inuse--;
+    c->inuse--;
+    if(s->inuse == 0){
+      partial_remove(c, s);
+      c->nslabs--;
+      kfree((void*)s);
+    }
+  }
+  release(&c->lock);
+}
+
+// Allocate an object from cache c.
+// Returns 0 if out of memory.
+void*
+kmem_cache_alloc(struct kmem_cache *c)
+{
+  struct magazine *m;
+  void *obj = 0;
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == 0)
+    slab_refill(c, m);
+  if(m->n > 0){
+    obj = m->obj[--m->n];
+    m->nalloc++;
+  }
+  pop_off();
+  return obj;
+}
+
+// Free an object allocated from cache c.
+void
+kmem_cache_free(struct kmem_cache *c, void *obj)
+{
+  struct magazine *m;
+
+  if(((struct slab*)PGROUNDDOWN((uint64)obj))->cache != c)
+    panic("kmem_cache_free");
+
+  push_off();
+  m = &c->mag[cpuid()];
+  if(m->n == MAGSIZE)
+    slab_drain(c, m, MAGSIZE/2);
+  m->obj[m->n++] = obj;
+  pop_off();
+}
+
+// Copy statistics for up to n caches to the user array
+// at addr.  Returns the number copied, or -1.
+int
+slabstat(uint64 addr, int n)
+{
+  struct kmem_cache *c;
+  struct slabinfo si;
+  int i, ncache;
+
+  acquire(&slabs.lock);
+  ncache = slabs.n;
+  release(&slabs.lock);
+
+  for(i = 0; i < ncache && i < n; i++){
+    c = &slabs.cache[i];
+    memset(&si, 0, sizeof(si));
+    safestrcpy(si.name, c->name, sizeof(si.name));
+    si.size = c->size;
+    acquire(&c->lock);
+    si.slabs = c->nslabs;
+    si.total = c->nslabs * c->perslab;
+    si.active = c->inuse;
+    release(&c->lock);
+    // Magazines are read without their CPUs' cooperation,
+    // so these may be slightly stale.
+    for(int j = 0; j < NCPU; j++){
+      si.cached += __atomic_load_n(&c->mag[j].n, __ATOMIC_RELAXED);
+      si.nalloc += __atomic_load_n(&c->mag[j].nalloc, __ATOMIC_RELAXED);
+    }
+    if(si.cached > si.active)
+      si.cached = si.active;
+    si.active -= si.cached;
+    if(copyout(myproc()->pagetable, addr + i*sizeof(si), (char*)&si, sizeof(si)) < 0)
+      return -1;
+  }
+  return i;
+}
@@ -0,0 +1,11 @@
+// Slab cache statistics, for slabstat().
+// Both the kernel and user programs use this header file.
+struct slabinfo {
+  char name[16];
+  uint size;          // object size in bytes
+  uint active;        // objects allocated
+  uint cached;        // free objects held in per-CPU magazines
+  uint total;         // objects the cache's slabs can hold
+  uint slabs;         // pages in use by the cache
+  uint64 nalloc;      // allocations since boot
+};
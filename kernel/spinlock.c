@@ -81,6 +81,19 @@ holding(struct spinlock *lk)
   return r;
 }
 
+// Check whether this cpu holds any spinlock, in which
+// case it must not sleep.
+int
+holdingspin(void)
+{
+  int r;
+
+  push_off();
+  r = mycpu()->noff > 1;
+  pop_off();
+  return r;
+}
+
 // push_off/pop_off are like intr_off()/intr_on() except that they are matched:
 // it takes two pop_off()s to undo two push_off()s.  Also, if interrupts
 // are initially off, then push_off, pop_off leaves them off.
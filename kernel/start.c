@@ -7,6 +7,10 @@
 void main();
 void timerinit();
 
+#ifdef __riscv_vector
+extern int memvector;
+#endif
+
 // entry.S needs one stack per CPU.
 __attribute__ ((aligned (16))) char stack0[4096 * NCPU];
 
@@ -40,6 +44,13 @@ start()
   // ask for clock interrupts.
   timerinit();
 
+#ifdef __riscv_vector
+  // only machine mode can read misa; tell string.c whether
+  // it may use vector instructions.
+  if(r_misa() & (1L << ('V' - 'A')))
+    memvector = 1;
+#endif
+
   // keep each CPU's hartid in its tp register, for cpuid().
   int id = r_mhartid();
   w_tp(id);
@@ -60,7 +71,10 @@ timerinit()
   
   // allow supervisor to use stimecmp and time.
   w_mcounteren(r_mcounteren() | 2);
+
+  // allow user mode to read time too, for timing benchmarks.
+  w_scounteren(r_scounteren() | 2);
   
   // ask for the very first timer interrupt.
-  w_stimecmp(r_time() + 1000000);
+  w_stimecmp(r_time() + TICK);
 }
@@ -1,13 +1,99 @@
 #include "types.h"
 
+// memset(), memmove() and memcmp() work a 64-bit word at a time,
+// eight words per loop iteration, once the addresses are word
+// aligned, with byte loops for the unaligned head and the tail.
+// user/ulib.c's programs link this file too (built with
+// -DUSERLIB), so both sides get the same routines.
+
+#define WSIZE sizeof(uint64)
+#define ALIGNED(p) (((uint64)(p) & (WSIZE-1)) == 0)
+
+#if defined(__riscv_vector) && !defined(USERLIB)
+#include "riscv.h"
+#include "defs.h"
+
+// Set by start() if misa says the harts have the V extension.
+int memvector;
+
+// Copies shorter than this aren't worth turning vectors on for.
+#define VECMIN 256
+
+// Copy n bytes forward with vector loads and stores.  The kernel
+// doesn't save vector registers, so vectors are enabled only here,
+// with interrupts off.
+static void
+vmemcpy(char *d, const char *s, uint64 n)
+{
+  uint64 vl;
+
+  push_off();
+  w_sstatus(r_sstatus() | SSTATUS_VS_INIT);
+  while(n > 0){
+    asm volatile("vsetvli %0, %1, e8, m8, ta, ma\n"
+                 "vle8.v v0, (%2)\n"
+                 "vse8.v v0, (%3)\n"
+                 : "=&r" (vl) : "r" (n), "r" (s), "r" (d) : "memory");
+    s += vl;
+    d += vl;
+    n -= vl;
+  }
+  w_sstatus(r_sstatus() & ~SSTATUS_VS);
+  pop_off();
+}
+
+static void
+vmemset(char *d, int c, uint64 n)
+{
+  uint64 vl;
+
+  push_off();
+  w_sstatus(r_sstatus() | SSTATUS_VS_INIT);
+  while(n > 0){
+    asm volatile("vsetvli %0, %1, e8, m8, ta, ma\n"
+                 "vmv.v.x v0, %2\n"
+                 "vse8.v v0, (%3)\n"
+                 : "=&r" (vl) : "r" (n), "r" (c), "r" (d) : "memory");
+    d += vl;
+    n -= vl;
+  }
+  w_sstatus(r_sstatus() & ~SSTATUS_VS);
+  pop_off();
+}
+#endif
+
 void*
 memset(void *dst, int c, uint n)
 {
-  char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
+  char *d = (char *) dst;
+  uint64 w, *wd;
+
+#if defined(__riscv_vector) && !defined(USERLIB)
+  if(memvector && n >= VECMIN){
+    vmemset(d, c, n);
+    return dst;
+  }
+#endif
+  while(n > 0 && !ALIGNED(d)){
+    *d++ = c;
+    n--;
+  }
+  if(n >= WSIZE){
+    w = (uchar)c;
+    w |= w << 8;
+    w |= w << 16;
+    w |= w << 32;
+    wd = (uint64 *) d;
+    for(; n >= 8*WSIZE; n -= 8*WSIZE, wd += 8){
+      wd[0] = w; wd[1] = w; wd[2] = w; wd[3] = w;
+      wd[4] = w; wd[5] = w; wd[6] = w; wd[7] = w;
+    }
+    for(; n >= WSIZE; n -= WSIZE)
+      *wd++ = w;
+    d = (char *) wd;
   }
+  while(n-- > 0)
+    *d++ = c;
   return dst;
 }
 
@@ -18,6 +104,20 @@ memcmp(const void *v1, const void *v2, uint n)
 
   s1 = v1;
   s2 = v2;
+  // compare words while both are aligned, and leave the
+  // word that differs, if any, to the byte loop.
+  if(((uint64)s1 & (WSIZE-1)) == ((uint64)s2 & (WSIZE-1))){
+    while(n > 0 && !ALIGNED(s1)){
+      if(*s1 != *s2)
+        return *s1 - *s2;
+      s1++, s2++, n--;
+    }
+    while(n >= WSIZE && *(const uint64 *)s1 == *(const uint64 *)s2){
+      s1 += WSIZE;
+      s2 += WSIZE;
+      n -= WSIZE;
+    }
+  }
   while(n-- > 0){
     if(*s1 != *s2)
       return *s1 - *s2;
@@ -27,6 +127,76 @@ memcmp(const void *v1, const void *v2, uint n)
   return 0;
 }
 
+// Copy n bytes forward, d below s or not overlapping.
+static void
+copyfwd(char *d, const char *s, uint n)
+{
+  uint64 *wd, lo, hi;
+  const uint64 *ws;
+  int sh;
+
+  while(n > 0 && !ALIGNED(d)){
+    *d++ = *s++;
+    n--;
+  }
+  wd = (uint64 *) d;
+  if(ALIGNED(s)){
+    ws = (const uint64 *) s;
+    for(; n >= 8*WSIZE; n -= 8*WSIZE, wd += 8, ws += 8){
+      wd[0] = ws[0]; wd[1] = ws[1]; wd[2] = ws[2]; wd[3] = ws[3];
+      wd[4] = ws[4]; wd[5] = ws[5]; wd[6] = ws[6]; wd[7] = ws[7];
+    }
+    for(; n >= WSIZE; n -= WSIZE)
+      *wd++ = *ws++;
+    s = (const char *) ws;
+  } else if(n >= 2*WSIZE){
+    // s isn't aligned: load aligned words and shift them
+    // together, since misaligned loads may trap.  The loads
+    // stay inside the words that hold s[0..n-1].
+    sh = ((uint64)s & (WSIZE-1)) * 8;
+    ws = (const uint64 *) (s - sh/8);
+    lo = *ws++;
+    for(; n >= 2*WSIZE; n -= WSIZE, s += WSIZE){
+      hi = *ws++;
+      *wd++ = (lo >> sh) | (hi << (64 - sh));
+      lo = hi;
+    }
+  }
+  d = (char *) wd;
+  while(n-- > 0)
+    *d++ = *s++;
+}
+
+// Copy n bytes backward, for d above s and overlapping.
+// d and s point just past the ends.
+static void
+copyback(char *d, const char *s, uint n)
+{
+  uint64 *wd;
+  const uint64 *ws;
+
+  if(((uint64)s & (WSIZE-1)) == ((uint64)d & (WSIZE-1))){
+    while(n > 0 && !ALIGNED(d)){
+      *--d = *--s;
+      n--;
+    }
+    wd = (uint64 *) d;
+    ws = (const uint64 *) s;
+    for(; n >= 8*WSIZE; n -= 8*WSIZE){
+      wd -= 8;
+      ws -= 8;
+      wd[7] = ws[7]; wd[6] = ws[6]; wd[5] = ws[5]; wd[4] = ws[4];
+      wd[3] = ws[3]; wd[2] = ws[2]; wd[1] = ws[1]; wd[0] = ws[0];
+    }
+    for(; n >= WSIZE; n -= WSIZE)
+      *--wd = *--ws;
+    d = (char *) wd;
+    s = (const char *) ws;
+  }
+  while(n-- > 0)
+    *--d = *--s;
+}
+
 void*
 memmove(void *dst, const void *src, uint n)
 {
@@ -39,13 +209,16 @@ memmove(void *dst, const void *src, uint n)
   s = src;
   d = dst;
   if(s < d && s + n > d){
-    s += n;
-    d += n;
-    while(n-- > 0)
-      *--d = *--s;
-  } else
-    while(n-- > 0)
-      *d++ = *s++;
+    copyback(d + n, s + n, n);
+  } else {
+#if defined(__riscv_vector) && !defined(USERLIB)
+    if(memvector && n >= VECMIN){
+      vmemcpy(d, s, n);
+      return dst;
+    }
+#endif
+    copyfwd(d, s, n);
+  }
 
   return dst;
 }
@@ -95,6 +268,8 @@ safestrcpy(char *s, const char *t, int n)
   return os;
 }
 
+#ifndef USERLIB
+// ulib.c has its own, returning uint.
 int
 strlen(const char *s)
 {
@@ -104,4 +279,4 @@ strlen(const char *s)
     ;
   return n;
 }
-
+#endif
@@ -0,0 +1,265 @@
+// Swapping user pages out to disk.
+//
+// mkfs reserves sb.nswap blocks after the file system, which
+// hold one page per slot of PGSIZE/BSIZE blocks.  A swapped-out
+// page's PTE has PTE_V clear, PTE_SWAP set, and its slot in
+// place of the physical page number; its R/W/X/U bits are kept,
+// so vmfault() can read it back with the same permissions.
+// fork() copies such a PTE to the child and counts another
+// reference to the slot, and each reader takes its own copy.
+//
+// Pages to swap out are picked by a clock sweep over every
+// process's memory below p->sz.  A page with PTE_A set gets a
+// second chance: the sweep clears PTE_A and passes it over.
+// Only pages one process owns outright are candidates, not
+// megapages, copy-on-write pages or mmap() regions.
+//
+// The kernel may hold a user page's physical address across a
+// preemption, say in the middle of a copyout(), but not across
+// a sleep unless it holds a reference of its own, as uvmcopy()
+// does, so the sweep only takes pages from SLEEPING processes,
+// and from the caller itself in swapreclaim().
+// Since ASIDs keep a process's TLB entries across switches,
+// clearing PTE_V goes through uvmflush(), which flushes the page
+// for the caller and takes a sleeping process's ASID away, so it
+// starts afresh when it next runs.  Clearing PTE_A isn't flushed:
+// a stale entry at worst lets a page skip its second chance.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "fs.h"
+#include "buf.h"
+#include "proc.h"
+#include "defs.h"
+#include "swap.h"
+
+#define SLOTBLOCKS (PGSIZE / BSIZE)
+#define NSLOT (SWAPSIZE / SLOTBLOCKS)
+
+extern struct proc proc[NPROC];
+
+struct {
+  struct spinlock lock;   // protects ref[], next and inuse
+  ushort ref[NSLOT];      // PTEs naming each slot; 0 if free
+  uint next;              // slot to try first
+  uint inuse;
+
+  // swapping out holds io from choosing a page until it is on
+  // disk, so a page can't be read back, or its slot reused,
+  // before it has been written.
+  struct sleeplock io;
+  struct buf buf;         // for transfers, under io
+  int hand;               // clock hand: proc[hand], at handva
+  uint64 handva;
+  uint64 swapouts;
+  uint64 swapins;
+
+  int dev;
+  uint start;             // first swap block
+  uint nslot;             // 0 if there's no swap area
+} swap;
+
+void
+swapinit(int dev, struct superblock *sb)
+{
+  initlock(&swap.lock, "swap");
+  initsleeplock(&swap.io, "swapio");
+  swap.dev = dev;
+  swap.start = sb->swapstart;
+  swap.nslot = sb->nswap / SLOTBLOCKS;
+  if(swap.nslot > NSLOT)
+    swap.nslot = NSLOT;
+}
+
+// Claim a free slot.  Returns -1 if swap is full.
+static int
+slotalloc(void)
+{
+  uint s;
+
+  acquire(&swap.lock);
+  for(uint i = 0; i < swap.nslot; i++){
+    s = (swap.next + i) % swap.nslot;
+    if(swap.ref[s] == 0){
+      swap.ref[s] = 1;
+      swap.next = s + 1;
+      swap.inuse++;
+      release(&swap.lock);
+      return s;
+    }
+  }
+  release(&swap.lock);
+  return -1;
+}
+
+// Add a reference to slot s, for a PTE copied by fork().
+void
+swapdup(uint s)
+{
+  acquire(&swap.lock);
+  swap.ref[s]++;
+  release(&swap.lock);
+}
+
+// Drop a PTE's reference to slot s.
+void
+swapfree(uint s)
+{
+  acquire(&swap.lock);
+  if(s >= swap.nslot || swap.ref[s] == 0)
+    panic("swapfree");
+  if(--swap.ref[s] == 0)
+    swap.inuse--;
+  release(&swap.lock);
+}
+
+// Copy the page at pa to slot s, or from it if !write.
+// Caller holds swap.io.
+static void
+swapio(uint s, char *pa, int write)
+{
+  struct buf *b = &swap.buf;
+
+  for(int i = 0; i < SLOTBLOCKS; i++){
+    b->dev = swap.dev;
+    b->blockno = swap.start + s*SLOTBLOCKS + i;
+    if(write)
+      memmove(b->data, pa + i*BSIZE, BSIZE);
+    virtio_disk_rw(b, write);
+    if(!write)
+      memmove(pa + i*BSIZE, b->data, BSIZE);
+  }
+}
+
+// Move the clock hand on through p's memory to the next page
+// to swap out, clearing PTE_A on the pages it passes.  Skips
+// a whole 2 MiB at a time where there's no level-0 page-table
+// page.  Returns the page's PTE, or 0 at p->sz.  Caller holds
+// swap.io and p->lock.
+static pte_t *
+sweep(struct proc *p)
+{
+  pte_t *l1, *pte;
+  uint64 va;
+
+  for(va = swap.handva; va < p->sz; va += PGSIZE){
+    l1 = walkmega(p->pagetable, va, 0);
+    if(l1 == 0 || (*l1 & PTE_V) == 0 || PTE_LEAF(*l1)){
+      va = MEGAROUNDDOWN(va) + MEGAPGSIZE - PGSIZE;
+      continue;
+    }
+    pte = &((pagetable_t)PTE2PA(*l1))[PX(0, va)];
+    if((*pte & (PTE_V|PTE_U|PTE_COW)) != (PTE_V|PTE_U) ||
+       krefcnt((void*)PTE2PA(*pte)) != 1)
+      continue;
+    if(*pte & PTE_A){
+      *pte &= ~PTE_A;
+      continue;
+    }
+    swap.handva = va + PGSIZE;
+    return pte;
+  }
+  return 0;
+}
+
+// Write one page out to swap and free it, taking it from a
+// sleeping process or, if self is set, from the caller.
+// Returns 0, or -1 if swap is full or no page can be found.
+int
+swapout(int self)
+{
+  struct proc *p;
+  pte_t *pte;
+  char *pa;
+  int s;
+
+  if(swap.nslot == 0 || swap.inuse == swap.nslot)
+    return -1;
+
+  acquiresleep(&swap.io);
+  // two turns of the clock, since the first may only
+  // clear PTE_A bits.
+  for(int n = 0; n <= 2*NPROC; n++){
+    p = &proc[swap.hand];
+    acquire(&p->lock);
+    if(p->state == SLEEPING || (self && p == myproc())){
+      if((pte = sweep(p)) != 0){
+        if((s = slotalloc()) < 0){
+          release(&p->lock);
+          break;
+        }
+        pa = (char*)PTE2PA(*pte);
+        *pte = SLOT2PTE(s) | (PTE_FLAGS(*pte) & ~(PTE_V|PTE_A|PTE_D)) | PTE_SWAP;
+        uvmflush(p->pagetable, swap.handva - PGSIZE, PGSIZE);
+        p->acct.rss--;
+        p->acct.swapped++;
+        release(&p->lock);
+        swapio(s, pa, 1);
+        swap.swapouts++;
+        releasesleep(&swap.io);
+        kfree(pa);
+        return 0;
+      }
+    }
+    release(&p->lock);
+    swap.hand = (swap.hand + 1) % NPROC;
+    swap.handva = 0;
+  }
+  releasesleep(&swap.io);
+  return -1;
+}
+
+// Swap out pages, the caller's included, until n pages are
+// free.  Always swaps out at least one.  The caller must not
+// hold a spinlock, nor a physical address in its own memory
+// that it will use again.  Returns 0, or -1 if no page could
+// be swapped out.
+int
+swapreclaim(int n)
+{
+  if(swapout(1) < 0)
+    return -1;
+  while(getfreepages() < n && swapout(1) == 0)
+    ;
+  return 0;
+}
+
+// Read the page that swapped-out PTE *pte, in the caller's
+// page table, names into a new page, map it there, and drop
+// the slot.  Returns the physical address, or 0 if out of
+// memory.
+uint64
+swapin(pte_t *pte)
+{
+  struct memacct *a = &myproc()->acct;
+  char *mem;
+  uint s = PTE2SLOT(*pte);
+
+  if((mem = kalloc()) == 0)
+    return 0;
+  acquiresleep(&swap.io);
+  swapio(s, mem, 0);
+  swap.swapins++;
+  releasesleep(&swap.io);
+  *pte = PA2PTE(mem) | (PTE_FLAGS(*pte) & ~PTE_SWAP) | PTE_V;
+  swapfree(s);
+  a->swapped--;
+  if(++a->rss > a->peak)
+    a->peak = a->rss;
+  return (uint64)mem;
+}
+
+void
+getswapstat(struct swapstat *st)
+{
+  acquire(&swap.lock);
+  st->nslot = swap.nslot;
+  st->inuse = swap.inuse;
+  release(&swap.lock);
+  st->swapouts = __atomic_load_n(&swap.swapouts, __ATOMIC_RELAXED);
+  st->swapins = __atomic_load_n(&swap.swapins, __ATOMIC_RELAXED);
+}
@@ -0,0 +1,8 @@
+// Swap statistics, for memstat().
+// Both the kernel and user programs use this header file.
+struct swapstat {
+  uint64 nslot;       // pages of swap space
+  uint64 inuse;       // slots holding a page
+  uint64 swapouts;    // pages written out since boot
+  uint64 swapins;     // pages read back since boot
+};
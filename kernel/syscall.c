@@ -112,6 +112,22 @@ extern uint64 sys_buffer_init(void);
 extern uint64 sys_produce(void);
 extern uint64 sys_consume(void);
 extern uint64 sys_buffer_status(void);
+// Scheduler performance work
+extern uint64 sys_setsched(void);
+extern uint64 sys_lendtickets(void);
+extern uint64 sys_mkcurrency(void);
+extern uint64 sys_setquantum(void);
+extern uint64 sys_settickless(void);
+extern uint64 sys_getpinfo(void);
+extern uint64 sys_slabstat(void);
+extern uint64 sys_madvise(void);
+extern uint64 sys_mmap(void);
+extern uint64 sys_munmap(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_getminfo(void);
+extern uint64 sys_setmemlimit(void);
+extern uint64 sys_mkmemgroup(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -148,6 +164,22 @@ static uint64 (*syscalls[])(void) = {
 [SYS_produce]        sys_produce,
 [SYS_consume]        sys_consume,
 [SYS_buffer_status]  sys_buffer_status,
+// Scheduler performance work
+[SYS_setsched]       sys_setsched,
+[SYS_lendtickets]    sys_lendtickets,
+[SYS_mkcurrency]     sys_mkcurrency,
+[SYS_setquantum]     sys_setquantum,
+[SYS_settickless]    sys_settickless,
+[SYS_getpinfo]       sys_getpinfo,
+[SYS_slabstat]       sys_slabstat,
+[SYS_madvise]        sys_madvise,
+[SYS_mmap]           sys_mmap,
+[SYS_munmap]         sys_munmap,
+[SYS_readv]          sys_readv,
+[SYS_writev]         sys_writev,
+[SYS_getminfo]       sys_getminfo,
+[SYS_setmemlimit]    sys_setmemlimit,
+[SYS_mkmemgroup]     sys_mkmemgroup,
 };
 
 void
@@ -31,3 +31,19 @@
 #define SYS_produce       28  // Producer: add item to buffer
 #define SYS_consume       29  // Consumer: remove item from buffer
 #define SYS_buffer_status 30  // Get buffer status
+// Scheduler performance work
+#define SYS_setsched      31  // Switch lottery/stride policy
+#define SYS_lendtickets   32  // Lend tickets while blocked
+#define SYS_mkcurrency    33  // Start a ticket currency
+#define SYS_setquantum    34  // Set the caller's scheduling quantum
+#define SYS_settickless   35  // Turn tickless idle on or off
+#define SYS_getpinfo      36  // Copy out per-process scheduling stats
+#define SYS_slabstat      37  // Copy out slab cache usage
+#define SYS_madvise       38  // Advise on or prefault lazy heap ranges
+#define SYS_mmap          39  // Map a file into memory
+#define SYS_munmap        40  // Unmap an mmap() region
+#define SYS_readv         41  // Read into several buffers
+#define SYS_writev        42  // Write from several buffers
+#define SYS_getminfo      43  // Copy out per-process memory usage
+#define SYS_setmemlimit   44  // Limit the caller's pages
+#define SYS_mkmemgroup    45  // Start a memory group with a page limit
@@ -15,6 +15,8 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "mman.h"
+#include "uio.h"
 
 // Fetch the nth word-sized system call argument as a file descriptor
 // and return both the descriptor and the corresponding struct file.
@@ -94,6 +96,52 @@ sys_write(void)
   return filewrite(f, p, n);
 }
 
+// Read into, or write from, the buffers described by the
+// user's iovec array, in order, stopping at a short transfer.
+// Returns the total bytes moved, or -1.
+static int
+filerwv(int write)
+{
+  struct iovec iov[UIO_MAXIOV];
+  struct file *f;
+  uint64 uiov;
+  int iovcnt, i, n, r, total = 0;
+
+  argaddr(1, &uiov);
+  argint(2, &iovcnt);
+  if(argfd(0, 0, &f) < 0 || iovcnt < 0 || iovcnt > UIO_MAXIOV)
+    return -1;
+  if(copyin(myproc()->pagetable, (char*)iov, uiov, iovcnt*sizeof(iov[0])) < 0)
+    return -1;
+  for(i = 0; i < iovcnt; i++){
+    if(iov[i].iov_len > 0x7fffffff - total)
+      return -1;
+    n = iov[i].iov_len;
+    if(write)
+      r = filewrite(f, (uint64)iov[i].iov_base, n);
+    else
+      r = fileread(f, (uint64)iov[i].iov_base, n);
+    if(r < 0)
+      return total > 0 ? total : -1;
+    total += r;
+    if(r < n)
+      break;
+  }
+  return total;
+}
+
+uint64
+sys_readv(void)
+{
+  return filerwv(0);
+}
+
+uint64
+sys_writev(void)
+{
+  return filerwv(1);
+}
+
 uint64
 sys_close(void)
 {
@@ -503,3 +551,38 @@ sys_pipe(void)
   }
   return 0;
 }
+
+uint64
+sys_mmap(void)
+{
+  struct file *f;
+  uint64 addr;
+  int len, prot, flags, off;
+
+  argaddr(0, &addr);  // hint, ignored
+  argint(1, &len);
+  argint(2, &prot);
+  argint(3, &flags);
+  argint(5, &off);
+  if(len <= 0 || off < 0)
+    return -1;
+  if(flags & MAP_ANON){
+    f = 0;
+    off = 0;
+  } else if(argfd(4, 0, &f) < 0)
+    return -1;
+  return vmamap(f, len, prot, flags, off);
+}
+
+uint64
+sys_munmap(void)
+{
+  uint64 addr;
+  int len;
+
+  argaddr(0, &addr);
+  argint(1, &len);
+  if(len <= 0)
+    return -1;
+  return vmaunmap(myproc(), addr, len);
+}
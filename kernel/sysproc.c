@@ -6,6 +6,7 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "vm.h"
+#include "swap.h"
 
 uint64
 sys_exit(void)
@@ -57,7 +58,7 @@ sys_sbrk(void)
     // memory, vmfault() will allocate it.
     if(addr + n < addr)
       return -1;
-    if(addr + n > TRAPFRAME)
+    if(addr + n > vmabase(myproc()))
       return -1;
     myproc()->sz += n;
   }
@@ -114,6 +115,7 @@ sys_settickets(void)
   int n;
   argint(0, &n);
   if(n < 1) n = 1; // Minimum 1 ticket
+  if(n > MAXTICKETS) n = MAXTICKETS;
 
   acquire(&myproc()->lock);
   myproc()->tickets = n;
@@ -121,10 +123,129 @@ sys_settickets(void)
   return 0;
 }
 
+// Switch the scheduling policy (SCHED_LOTTERY or SCHED_STRIDE).
+// Returns the previous policy, or -1 if the policy is unknown.
+uint64
+sys_setsched(void)
+{
+  int policy;
+  argint(0, &policy);
+  return setsched(policy);
+}
+
+// Lend the caller's tickets to pid while the caller is blocked.
+// pid 0 stops lending.
+uint64
+sys_lendtickets(void)
+{
+  int pid;
+  argint(0, &pid);
+  return lendtickets(pid);
+}
+
+// Fund a new ticket currency and move the caller into it.
+// Returns the currency id, or -1.
+uint64
+sys_mkcurrency(void)
+{
+  int funding;
+  argint(0, &funding);
+  return mkcurrency(funding);
+}
+
+// Set the caller's quantum in timer cycles; 0 makes it adaptive.
+uint64
+sys_setquantum(void)
+{
+  int n;
+  argint(0, &n);
+  return setquantum(n);
+}
+
+// Turn tickless idle on (1) or off (0).
+// Returns the previous setting.
+uint64
+sys_settickless(void)
+{
+  int on;
+  argint(0, &on);
+  return settickless(on);
+}
+
+// Fill a user array of n struct pinfo.
+// Returns the number of processes reported.
+uint64
+sys_getpinfo(void)
+{
+  uint64 addr;
+  int n;
+  argaddr(0, &addr);
+  argint(1, &n);
+  return getpinfo(addr, n);
+}
+
 // ============================================================
 // Phase 2: Memory Enhancement System Calls
 // ============================================================
 
+// Fill a user array of n struct minfo.
+// Returns the number of processes reported.
+uint64
+sys_getminfo(void)
+{
+  uint64 addr;
+  int n;
+  argaddr(0, &addr);
+  argint(1, &n);
+  return getminfo(addr, n);
+}
+
+// Limit the caller to n pages of memory, 0 for no limit.
+uint64
+sys_setmemlimit(void)
+{
+  int n;
+  argint(0, &n);
+  return setmemlimit(n);
+}
+
+// Move the caller into a new memory group limited to n pages.
+// Returns the group's id.
+uint64
+sys_mkmemgroup(void)
+{
+  int n;
+  argint(0, &n);
+  return mkmemgroup(n);
+}
+
+// Fill a user array of n struct slabinfo.
+// Returns the number of caches reported.
+uint64
+sys_slabstat(void)
+{
+  uint64 addr;
+  int n;
+  argaddr(0, &addr);
+  argint(1, &n);
+  return slabstat(addr, n);
+}
+
+// Advise the kernel how [addr, addr+len) will be used;
+// see kernel/mman.h.
+uint64
+sys_madvise(void)
+{
+  uint64 addr;
+  int len, advice;
+  argaddr(0, &addr);
+  argint(1, &len);
+  argint(2, &advice);
+  if(len < 0)
+    return -1;
+  return uvmadvise(addr, len, advice);
+}
+
 // Get memory statistics: returns free memory in bytes
 uint64
 sys_freemem(void)
@@ -135,16 +256,23 @@ sys_freemem(void)
 // Get detailed memory statistics
 // arg0: pointer to store free pages count
 // arg1: pointer to store total allocations count
+// arg2: array of MAXORDER+1 free block counts by order, or 0
+// arg3: pointer to a struct swapstat, or 0
 uint64
 sys_memstat(void)
 {
-  uint64 freepages_addr, totalalloc_addr;
+  uint64 freepages_addr, totalalloc_addr, freeblocks_addr, swapstat_addr;
   uint64 freepages, totalalloc;
+  uint64 freeblocks[MAXORDER+1];
+  struct swapstat ss;
   
   argaddr(0, &freepages_addr);
   argaddr(1, &totalalloc_addr);
+  argaddr(2, &freeblocks_addr);
+  argaddr(3, &swapstat_addr);
   
-  getmemstat(&freepages, &totalalloc);
+  getmemstat(&freepages, &totalalloc, freeblocks);
+  getswapstat(&ss);
   
   // Copy results to user space
   struct proc *p = myproc();
@@ -152,6 +280,12 @@ sys_memstat(void)
     return -1;
   if(copyout(p->pagetable, totalalloc_addr, (char*)&totalalloc, sizeof(totalalloc)) < 0)
     return -1;
+  if(freeblocks_addr != 0 &&
+     copyout(p->pagetable, freeblocks_addr, (char*)freeblocks, sizeof(freeblocks)) < 0)
+    return -1;
+  if(swapstat_addr != 0 &&
+     copyout(p->pagetable, swapstat_addr, (char*)&ss, sizeof(ss)) < 0)
+    return -1;
     
   return 0;
 }
@@ -9,6 +9,9 @@
 struct spinlock tickslock;
 uint ticks;
 
+static uint64 nexttick;   // r_time() of CPU 0's next clock tick
+int tickless;             // idle CPUs other than 0 take no timer interrupts
+
 extern char trampoline[], uservec[];
 
 // in kernelvec.S, calls kerneltrap().
@@ -47,6 +50,7 @@ usertrap(void)
   w_stvec((uint64)kernelvec);  //DOC: kernelvec
 
   struct proc *p = myproc();
+  int k;
   
   // save user program counter.
   p->trapframe->epc = r_sepc();
@@ -54,8 +58,8 @@ usertrap(void)
   if(r_scause() == 8){
     // system call
 
-    if(killed(p))
-      kexit(-1);
+    if((k = killed(p)) != 0)
+      kexit(k);
 
     // sepc points to the ecall instruction,
     // but we want to return to the next instruction.
@@ -68,26 +72,32 @@ usertrap(void)
     syscall();
   } else if((which_dev = devintr()) != 0){
     // ok
-  } else if((r_scause() == 15 || r_scause() == 13) &&
-            vmfault(p->pagetable, r_stval(), (r_scause() == 13)? 1 : 0) != 0) {
+  } else if(r_scause() == 15 && cowfault(p->pagetable, r_stval()) != 0) {
+    // store to a copy-on-write page
+    p->faults++;
+  } else if((r_scause() == 15 || r_scause() == 13 || r_scause() == 12) &&
+            vmfault(p->pagetable, r_stval(), (r_scause() != 15)? 1 : 0) != 0) {
     // page fault on lazily-allocated page
+    p->faults++;
+  } else if(killed(p)){
+    // vmfault() killed p for going over its memory limit.
   } else {
     printf("usertrap(): unexpected scause 0x%lx pid=%d\n", r_scause(), p->pid);
     printf("            sepc=0x%lx stval=0x%lx\n", r_sepc(), r_stval());
-    setkilled(p);
+    setkilled(p, -1);
   }
 
-  if(killed(p))
-    kexit(-1);
+  if((k = killed(p)) != 0)
+    kexit(k);
 
-  // give up the CPU if this is a timer interrupt.
+  // give up the CPU if its quantum has expired.
   if(which_dev == 2)
     yield();
 
   prepare_return();
 
   // the user page table to switch to, for trampoline.S
-  uint64 satp = MAKE_SATP(p->pagetable);
+  uint64 satp = uvmsatp(p);
 
   // return to trampoline.S; satp value in a0.
   return satp;
@@ -130,6 +140,25 @@ prepare_return(void)
   w_sepc(p->trapframe->epc);
 }
 
+#ifdef KPGTBL
+extern char ucopy_begin[], ucopy_end[], ucopy_fault[]; // ucopy.S
+
+// Handle a page fault at stval in ucopy.S, on the current
+// process's memory: fault the page in, or if that fails,
+// return to ucopy_fault.  Returns the pc to resume at.
+static uint64
+ufixup(uint64 sepc, uint64 scause)
+{
+  struct proc *p = myproc();
+  uint64 va = r_stval();
+
+  if(ufault(p->pagetable, va, 1, scause == 15) < 0)
+    return (uint64)ucopy_fault;
+  uvmflush(p->pagetable, va, 1);
+  return sepc;
+}
+#endif
+
 // interrupts and exceptions from kernel code go here via kernelvec,
 // on whatever the current kernel stack is.
 void 
@@ -145,13 +174,25 @@ kerneltrap()
   if(intr_get() != 0)
     panic("kerneltrap: interrupts enabled");
 
+#ifdef KPGTBL
+  if((scause == 13 || scause == 15) &&
+     sepc >= (uint64)ucopy_begin && sepc < (uint64)ucopy_end){
+    // a load or store of user memory by ucopy(); ufixup()
+    // may sleep, so restore the trap registers after it.
+    sepc = ufixup(sepc, scause);
+    w_sepc(sepc);
+    w_sstatus(sstatus);
+    return;
+  }
+#endif
+
   if((which_dev = devintr()) == 0){
     // interrupt or trap from an unknown source
     printf("scause=0x%lx sepc=0x%lx stval=0x%lx\n", scause, r_sepc(), r_stval());
     panic("kerneltrap");
   }
 
-  // give up the CPU if this is a timer interrupt.
+  // give up the CPU if its quantum has expired.
   if(which_dev == 2 && myproc() != 0)
     yield();
 
@@ -161,26 +202,69 @@ kerneltrap()
   w_sstatus(sstatus);
 }
 
+// Arm this CPU's timer for the earlier of the end of the running
+// process's quantum and, on CPU 0, the next clock tick.  An idle
+// CPU wakes every tick to look for work to steal, unless tickless
+// is set; CPU 0 keeps ticking so that ticks and sleep() work.
+// Even tickless, an idle CPU wakes every IDLEMAX, since nothing
+// else would tell it that tickless has been turned off.
+// Writing stimecmp also clears a pending timer interrupt.
+// Interrupts must be disabled.
 void
+timerset(void)
+{
+  struct cpu *c = mycpu();
+  uint64 next = c->sliceend;
+
+  if(next == 0)
+    next = r_time() + ((tickless && cpuid() != 0) ? IDLEMAX : TICK);
+  if(cpuid() == 0 && nexttick < next)
+    next = nexttick;
+  w_stimecmp(next);
+}
+
+// Handle a timer interrupt.  Returns 1 if the running
+// process's quantum has expired, 0 otherwise.
+int
 clockintr()
 {
-  if(cpuid() == 0){
+  struct cpu *c = mycpu();
+  uint64 now = r_time();
+  int expired = 0;
+
+  if(cpuid() == 0 && now >= nexttick){
     acquire(&tickslock);
     ticks++;
     wakeup(&ticks);
     release(&tickslock);
+    nexttick = now + TICK;
   }
 
-  // ask for the next timer interrupt. this also clears
-  // the interrupt request. 1000000 is about a tenth
-  // of a second.
-  w_stimecmp(r_time() + 1000000);
+  if(c->sliceend != 0 && now >= c->sliceend){
+    c->sliceend = 0;
+    expired = 1;
+  }
+
+  // ask for the next timer interrupt.
+  timerset();
+  return expired;
+}
+
+// Turn tickless idle on or off.  Returns the previous setting.
+// CPUs already parked see the change within IDLEMAX.
+int
+settickless(int on)
+{
+  int old = tickless;
+
+  tickless = on != 0;
+  return old;
 }
 
 // check if it's an external interrupt or software interrupt,
 // and handle it.
-// returns 2 if timer interrupt,
-// 1 if other device,
+// returns 2 if a timer interrupt ended the running quantum,
+// 1 if other device or timer,
 // 0 if not recognized.
 int
 devintr()
@@ -210,8 +294,9 @@ devintr()
     return 1;
   } else if(scause == 0x8000000000000005L){
     // timer interrupt.
-    clockintr();
-    return 2;
+    if(clockintr())
+      return 2;
+    return 1;
   } else {
     return 0;
   }
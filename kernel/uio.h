@@ -0,0 +1,21 @@
+// Scatter/gather buffers, for readv() and writev().
+// Both the kernel and user programs use this header file.
+struct iovec {
+  void *iov_base;     // start of buffer
+  uint64 iov_len;     // bytes
+};
+
+#define UIO_MAXIOV 16  // most iovecs per readv() or writev()
+
+// A cursor for copying to and from one page table's user
+// memory.  It remembers the last page (or megapage) it
+// translated, so a copy that walks through a buffer in pieces
+// walks the page table once per page, not once per piece.
+// Only the kernel uses this.
+struct ucursor {
+  uint64 *pagetable;
+  uint64 start;       // user range [start, end) maps to pa
+  uint64 end;
+  uint64 pa;
+  int write;          // range is writable
+};
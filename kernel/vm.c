@@ -7,6 +7,9 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "fs.h"
+#include "mman.h"
+#include "uio.h"
+#include "meminfo.h"
 
 /*
  * the kernel's page table.
@@ -17,6 +20,86 @@ extern char etext[];  // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[]; // trampoline.S
 
+extern struct proc proc[NPROC];
+
+// The process each user page table charges its pages to, as
+// an index into proc[] plus one, by the table's root page.
+// exec() charges its new page table to the same process as
+// the old one; freeing the old one then takes its pages off.
+static uchar owner[(PHYSTOP - KERNBASE) / PGSIZE];
+#define OWNER(pagetable) owner[((uint64)(pagetable) - KERNBASE) / PGSIZE]
+
+static uint64 asidmax;  // largest ASID the CPUs implement, 0 if none
+#define FLUSHMAX 16     // pages uvmflush() flushes one by one
+
+// The counters for user page table pagetable, or 0 for the
+// kernel's.
+static struct memacct *
+acctof(pagetable_t pagetable)
+{
+  int i = OWNER(pagetable);
+
+  return i ? &proc[i-1].acct : 0;
+}
+
+// Add rss resident pages, pt page-table pages and swapped
+// swapped-out pages to pagetable's counters.
+static void
+charge(pagetable_t pagetable, int rss, int pt, int swapped)
+{
+  struct memacct *a;
+
+  if((a = acctof(pagetable)) == 0)
+    return;
+  a->rss += rss;
+  a->ptpages += pt;
+  a->swapped += swapped;
+  if(a->rss > a->peak)
+    a->peak = a->rss;
+  if(a->cg && rss + swapped != 0)
+    __atomic_add_fetch(&a->cg->charged, rss + swapped, __ATOMIC_RELAXED);
+}
+
+#define MEMROOM 0x7fffffff   // room() under no limit
+
+// How many more pages the process with counters a may charge
+// before it reaches its own limit or its group's.  Takes no
+// locks, so members of a group faulting at once on different
+// CPUs may overshoot its limit by a fault-around window each.
+static int
+room(struct memacct *a)
+{
+  int r = MEMROOM;
+
+  if(a->limit && a->limit - (a->rss + a->swapped) < r)
+    r = a->limit - (a->rss + a->swapped);
+  if(a->cg && a->cg->limit - __atomic_load_n(&a->cg->charged, __ATOMIC_RELAXED) < r)
+    r = a->cg->limit - __atomic_load_n(&a->cg->charged, __ATOMIC_RELAXED);
+  return r;
+}
+
+// How many more pages p may charge, for growproc().
+int
+uvmroom(struct proc *p)
+{
+  return room(&p->acct);
+}
+
+// Check that a page fault may map another page for p.  If
+// not, kill p, to exit with status EXIT_MEMLIMIT.  Returns
+// the pages p has room for, or 0.
+int
+uvmlimit(struct proc *p)
+{
+  int r;
+
+  if((r = room(&p->acct)) > 0)
+    return r;
+  printf("pid %d %s: over memory limit\n", p->pid, p->name);
+  setkilled(p, EXIT_MEMLIMIT);
+  return 0;
+}
+
 // Make a direct-map page table for the kernel.
 pagetable_t
 kvmmake(void)
@@ -51,14 +134,34 @@ kvmmake(void)
   return kpgtbl;
 }
 
-// add a mapping to the kernel page table.
+// add a mapping to the kernel page table, using 2 MiB
+// megapages for the parts of the range that are aligned.
 // only used when booting.
 // does not flush TLB or enable paging.
 void
 kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
 {
-  if(mappages(kpgtbl, va, sz, pa, perm) != 0)
-    panic("kvmmap");
+  pte_t *pte;
+  uint64 n;
+
+  while(sz > 0){
+    if(va % MEGAPGSIZE == 0 && pa % MEGAPGSIZE == 0 && sz >= MEGAPGSIZE){
+      if((pte = walkmega(kpgtbl, va, 1)) == 0 || *pte != 0)
+        panic("kvmmap");
+      *pte = PA2PTE(pa) | perm | PTE_V;
+      n = MEGAPGSIZE;
+    } else {
+      // 4 KiB pages up to the next megapage boundary.
+      n = MEGAPGSIZE - va % MEGAPGSIZE;
+      if(n > sz)
+        n = sz;
+      if(mappages(kpgtbl, va, n, pa, perm) != 0)
+        panic("kvmmap");
+    }
+    va += n;
+    pa += n;
+    sz -= n;
+  }
 }
 
 // Initialize the kernel_pagetable, shared by all CPUs.
@@ -76,12 +179,154 @@ kvminithart()
   // wait for any previous writes to the page table memory to finish.
   sfence_vma();
 
+  // find how many ASID bits satp has.
+  w_satp(MAKE_SATP(kernel_pagetable) | SATP_ASID(SATP_ASIDMAX));
+  asidmax = SATP2ASID(r_satp());
   w_satp(MAKE_SATP(kernel_pagetable));
 
   // flush stale entries from the TLB.
   sfence_vma();
 }
 
+// With KPGTBL, each process has its own copy of the kernel
+// page table's root page, whose entry for the first GiB is the
+// process's own level-1 page from its user page table.  The
+// kernel then reaches user memory below UMIRROR with plain loads
+// and stores (see ucopy.S), through the same page-table pages
+// the process uses, so there is nothing to keep in sync as pages
+// are mapped and unmapped.  The user page table's level-1 page
+// carries the kernel's device mappings above UMIRROR, without
+// PTE_U, so user code can't touch them.
+
+// Give p a kernel page table for p->pagetable.
+// Returns 0, or -1 if out of memory.
+int
+kvmcreate(struct proc *p)
+{
+#ifdef KPGTBL
+  if((p->kpagetable = kalloc()) == 0)
+    return -1;
+  memmove(p->kpagetable, kernel_pagetable, PGSIZE);
+  p->kpagetable[0] = p->pagetable[0];
+#endif
+  return 0;
+}
+
+// Free p's kernel page table.  The page-table pages
+// below it belong to the user or kernel page table.
+void
+kvmfree(struct proc *p)
+{
+  if(p->kpagetable)
+    kfree(p->kpagetable);
+  p->kpagetable = 0;
+}
+
+// Point p's kernel page table at a new p->pagetable,
+// installed by exec(), and drop the ASID of the old one.
+void
+kvmrelink(struct proc *p)
+{
+#ifdef KPGTBL
+  p->kpagetable[0] = p->pagetable[0];
+  sfence_vma();
+#endif
+  p->asid = 0;
+}
+
+// Get this CPU ready to run p, or the scheduler if p is 0:
+// with KPGTBL, switch to p's kernel page table, or to the
+// shared one.  The kernel always runs with ASID 0.
+void
+kvmswitch(struct proc *p)
+{
+  // an ASID from another CPU may have stale entries there.
+  if(p && p->asidcpu != cpuid())
+    p->asid = 0;
+#ifdef KPGTBL
+  pagetable_t pt = p ? p->kpagetable : kernel_pagetable;
+
+  // user ASIDs are tagged apart, so only ASID 0's entries,
+  // from the old kernel page table, need to go.
+  w_satp(MAKE_SATP(pt));
+  sfence_vma_asid(0);
+#endif
+}
+
+// ASIDs.  Each process enters user space with an ASID in satp,
+// so the TLB keeps its entries apart from the kernel's (ASID 0)
+// and other processes', and neither trampoline.S nor a context
+// switch has to flush it.  Each CPU hands out its own ASIDs, in
+// generations: when they run out, the CPU flushes its TLB and
+// starts a new generation, and a process holding an ASID from
+// an old one, or from another CPU, gets a new one when it next
+// enters user space.  So a process's TLB entries can only be
+// on the CPU it has its ASID from, and uvmflush() need only
+// flush that CPU's.  A CPU with no ASID bits runs everything
+// as ASID 0, and trampoline.S flushes the whole TLB instead.
+
+// The satp value for p's user page table, with an ASID
+// for p on this CPU.  Interrupts must be off.
+uint64
+uvmsatp(struct proc *p)
+{
+  struct cpu *c = mycpu();
+
+  if(asidmax == 0)
+    return MAKE_SATP(p->pagetable);
+  if(p->asid == 0 || (p->asid & ~asidmax) != c->asidgen){
+    if(c->asidnext == 0 || c->asidnext > asidmax){
+      // out of ASIDs: a new generation.
+      c->asidgen += asidmax + 1;
+      c->asidnext = 1;
+      sfence_vma();
+    }
+    p->asid = c->asidgen | c->asidnext++;
+    p->asidcpu = cpuid();
+  }
+  return MAKE_SATP(p->pagetable) | SATP_ASID(p->asid & asidmax);
+}
+
+// Flush the TLB entries for user addresses [va, va+len) of
+// pagetable after changing their PTEs: a page at a time for a
+// few pages, else all of pagetable's.  If pagetable belongs to
+// a process that isn't the caller, the process can't be
+// running, and just loses its ASID.
+void
+uvmflush(pagetable_t pagetable, uint64 va, uint64 len)
+{
+  struct proc *p;
+  uint64 a, asid;
+
+  if(OWNER(pagetable) == 0)
+    return;
+  p = &proc[OWNER(pagetable) - 1];
+  if(p->pagetable != pagetable)
+    return;   // exec()'s new page table, not in use yet
+  if(p != myproc()){
+    p->asid = 0;
+    return;
+  }
+
+  // the kernel's ASID 0 entries only map user memory with KPGTBL.
+  asid = p->asid & asidmax;
+  if(len > FLUSHMAX*PGSIZE){
+    if(asid)
+      sfence_vma_asid(asid);
+#ifdef KPGTBL
+    sfence_vma_asid(0);
+#endif
+    return;
+  }
+  for(a = PGROUNDDOWN(va); a < va + len; a += PGSIZE){
+    if(asid)
+      sfence_vma_page(a, asid);
+#ifdef KPGTBL
+    sfence_vma_page(a, 0);
+#endif
+  }
+}
+
 // Return the address of the PTE in page table pagetable
 // that corresponds to virtual address va.  If alloc!=0,
 // create any required page-table pages.
@@ -94,26 +339,114 @@ kvminithart()
 //   21..29 -- 9 bits of level-1 index.
 //   12..20 -- 9 bits of level-0 index.
 //    0..11 -- 12 bits of byte offset within the page.
+//
+// If va lies in a 2 MiB megapage, returns the level-1 PTE
+// that maps it.
 pte_t *
 walk(pagetable_t pagetable, uint64 va, int alloc)
 {
+  pagetable_t root = pagetable;
+
   if(va >= MAXVA)
     panic("walk");
 
   for(int level = 2; level > 0; level--) {
     pte_t *pte = &pagetable[PX(level, va)];
     if(*pte & PTE_V) {
+      if(PTE_LEAF(*pte))
+        return pte;   // megapage
       pagetable = (pagetable_t)PTE2PA(*pte);
     } else {
-      if(!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+      if(!alloc || (pagetable = (pde_t*)kzalloc()) == 0)
         return 0;
-      memset(pagetable, 0, PGSIZE);
       *pte = PA2PTE(pagetable) | PTE_V;
+      charge(root, 0, 1, 0);
     }
   }
   return &pagetable[PX(0, va)];
 }
 
+// Return the address of the level-1 PTE for va, which either
+// maps a whole megapage or points to a level-0 page-table page.
+// If alloc!=0, create the level-1 page-table page if needed.
+pte_t *
+walkmega(pagetable_t pagetable, uint64 va, int alloc)
+{
+  pagetable_t root = pagetable;
+  pte_t *pte;
+
+  if(va >= MAXVA)
+    panic("walkmega");
+
+  pte = &pagetable[PX(2, va)];
+  if(*pte & PTE_V) {
+    pagetable = (pagetable_t)PTE2PA(*pte);
+  } else {
+    if(!alloc || (pagetable = (pde_t*)kzalloc()) == 0)
+      return 0;
+    *pte = PA2PTE(pagetable) | PTE_V;
+    charge(root, 0, 1, 0);
+  }
+  return &pagetable[PX(1, va)];
+}
+
+// If va lies in a megapage, return its level-1 PTE, else 0.
+static pte_t *
+megapte(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte = walkmega(pagetable, va, 0);
+
+  if(pte && (*pte & PTE_V) && PTE_LEAF(*pte))
+    return pte;
+  return 0;
+}
+
+// Split the user megapage mapped by level-1 PTE *pte in
+// pagetable into 512 ordinary pages with the same permissions,
+// so that parts of it can be unmapped or shared.  Returns 0,
+// or -1 if out of memory for the new page-table page.
+static int
+demote(pagetable_t pagetable, pte_t *pte)
+{
+  pagetable_t l0;
+  uint64 pa = PTE2PA(*pte);
+  uint flags = PTE_FLAGS(*pte);
+
+  if((l0 = (pagetable_t)kzalloc()) == 0)
+    return -1;
+  for(int i = 0; i < 512; i++)
+    l0[i] = PA2PTE(pa + i*PGSIZE) | flags;
+  ksplit((void*)pa, MEGAORDER);
+  *pte = PA2PTE(l0) | PTE_V;
+  charge(pagetable, 0, 1, 0);
+  uvmflush(pagetable, 0, MAXVA);
+  return 0;
+}
+
+// Try to back the whole 2 MiB-aligned block around va, which
+// must lie below sz, with a single zeroed megapage.  Fails if
+// any of the block already has a page-table page, or no free
+// 2 MiB block is left.  Returns the physical address for va,
+// or 0.
+static uint64
+uvmmega(pagetable_t pagetable, uint64 va, uint64 sz, int perm)
+{
+  uint64 base = MEGAROUNDDOWN(va);
+  pte_t *pte;
+  char *mem;
+
+  if(base + MEGAPGSIZE > sz)
+    return 0;
+  if((pte = walkmega(pagetable, base, 1)) == 0 || *pte != 0)
+    return 0;
+  if((mem = kalloc_order(MEGAORDER)) == 0)
+    return 0;
+  memset(mem, 0, MEGAPGSIZE);
+  *pte = PA2PTE(mem) | perm | PTE_V;
+  charge(pagetable, MEGAPGSIZE / PGSIZE, 0, 0);
+  return (uint64)mem + PGROUNDDOWN(va - base);
+}
+
 // Look up a virtual address, return the physical address,
 // or 0 if not mapped.
 // Can only be used to look up user pages.
@@ -134,12 +467,15 @@ walkaddr(pagetable_t pagetable, uint64 va)
   if((*pte & PTE_U) == 0)
     return 0;
   pa = PTE2PA(*pte);
+  if(megapte(pagetable, va) == pte)
+    pa += PGROUNDDOWN(va % MEGAPGSIZE);
   return pa;
 }
 
 // Create PTEs for virtual addresses starting at va that refer to
 // physical addresses starting at pa.
 // va and size MUST be page-aligned.
+// PTE_U pages count towards the owning process's RSS.
 // Returns 0 on success, -1 if walk() couldn't
 // allocate a needed page-table page.
 int
@@ -147,6 +483,7 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
 {
   uint64 a, last;
   pte_t *pte;
+  int n = 0, r = 0;
 
   if((va % PGSIZE) != 0)
     panic("mappages: va not aligned");
@@ -160,55 +497,102 @@ mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
   a = va;
   last = va + size - PGSIZE;
   for(;;){
-    if((pte = walk(pagetable, a, 1)) == 0)
-      return -1;
+    if((pte = walk(pagetable, a, 1)) == 0){
+      r = -1;
+      break;
+    }
     if(*pte & PTE_V)
       panic("mappages: remap");
     *pte = PA2PTE(pa) | perm | PTE_V;
+    n++;
     if(a == last)
       break;
     a += PGSIZE;
     pa += PGSIZE;
   }
-  return 0;
+  if(perm & PTE_U)
+    charge(pagetable, n, 0, 0);
+  return r;
 }
 
-// create an empty user page table.
+// create an empty user page table, charging its pages to p.
 // returns 0 if out of memory.
 pagetable_t
-uvmcreate()
+uvmcreate(struct proc *p)
 {
   pagetable_t pagetable;
   pagetable = (pagetable_t) kalloc();
   if(pagetable == 0)
     return 0;
   memset(pagetable, 0, PGSIZE);
+  OWNER(pagetable) = p - proc + 1;
+  charge(pagetable, 0, 1, 0);
+#ifdef KPGTBL
+  // the level-1 page for the first GiB, which the kernel page
+  // table shares, with the devices the kernel uses above UMIRROR.
+  pagetable_t l1, kl1;
+  if((l1 = kalloc()) == 0){
+    uvmfree(pagetable, 0);
+    return 0;
+  }
+  memset(l1, 0, PGSIZE);
+  kl1 = (pagetable_t)PTE2PA(kernel_pagetable[0]);
+  for(int i = PX(1, UMIRROR); i < 512; i++)
+    l1[i] = kl1[i];
+  pagetable[0] = PA2PTE(l1) | PTE_V;
+  charge(pagetable, 0, 1, 0);
+#endif
   return pagetable;
 }
 
 // Remove npages of mappings starting from va. va must be
 // page-aligned. It's OK if the mappings don't exist.
 // Optionally free the physical memory.
+// Megapages only partly in the range are split first.
 void
 uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-  uint64 a;
+  uint64 a, end = va + npages*PGSIZE;
   pte_t *pte;
+  int rss = 0, swapped = 0;
 
   if((va % PGSIZE) != 0)
     panic("uvmunmap: not aligned");
 
-  for(a = va; a < va + npages*PGSIZE; a += PGSIZE){
+  for(a = va; a < end; a += PGSIZE){
+    if((pte = megapte(pagetable, a)) != 0){
+      if(a % MEGAPGSIZE == 0 && a + MEGAPGSIZE <= end){
+        if(do_free)
+          kfree_order((void*)PTE2PA(*pte), MEGAORDER);
+        if(*pte & PTE_U)
+          rss += MEGAPGSIZE / PGSIZE;
+        *pte = 0;
+        a += MEGAPGSIZE - PGSIZE;
+        continue;
+      }
+      if(demote(pagetable, pte) < 0)
+        panic("uvmunmap: demote");
+    }
     if((pte = walk(pagetable, a, 0)) == 0) // leaf page table entry allocated?
       continue;   
+    if(*pte & PTE_SWAP){  // page is out in swap
+      swapfree(PTE2SLOT(*pte));
+      *pte = 0;
+      swapped++;
+      continue;
+    }
     if((*pte & PTE_V) == 0)  // has physical page been allocated?
       continue;
     if(do_free){
       uint64 pa = PTE2PA(*pte);
       kfree((void*)pa);
     }
+    if(*pte & PTE_U)
+      rss++;
     *pte = 0;
   }
+  charge(pagetable, -rss, 0, -swapped);
+  uvmflush(pagetable, va, npages*PGSIZE);
 }
 
 // Allocate PTEs and physical memory to grow a process from oldsz to
@@ -221,15 +605,23 @@ uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
 
   if(newsz < oldsz)
     return oldsz;
+#ifdef KPGTBL
+  if(newsz > UMIRROR)
+    return 0;
+#endif
 
   oldsz = PGROUNDUP(oldsz);
   for(a = oldsz; a < newsz; a += PGSIZE){
-    mem = kalloc();
+    // a whole aligned 2 MiB block: try a megapage.
+    if(a % MEGAPGSIZE == 0 && uvmmega(pagetable, a, newsz, PTE_R|PTE_U|xperm) != 0){
+      a += MEGAPGSIZE - PGSIZE;
+      continue;
+    }
+    mem = kzalloc();
     if(mem == 0){
       uvmdealloc(pagetable, a, oldsz);
       return 0;
     }
-    memset(mem, 0, PGSIZE);
     if(mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R|PTE_U|xperm) != 0){
       kfree(mem);
       uvmdealloc(pagetable, a, oldsz);
@@ -259,22 +651,26 @@ uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 
 // Recursively free page-table pages.
 // All leaf mappings must already have been removed.
-void
+// Returns the number of pages freed.
+int
 freewalk(pagetable_t pagetable)
 {
+  int n = 1;
+
   // there are 2^9 = 512 PTEs in a page table.
   for(int i = 0; i < 512; i++){
     pte_t pte = pagetable[i];
     if((pte & PTE_V) && (pte & (PTE_R|PTE_W|PTE_X)) == 0){
       // this PTE points to a lower-level page table.
       uint64 child = PTE2PA(pte);
-      freewalk((pagetable_t)child);
+      n += freewalk((pagetable_t)child);
       pagetable[i] = 0;
     } else if(pte & PTE_V){
       panic("freewalk: leaf");
     }
   }
   kfree((void*)pagetable);
+  return n;
 }
 
 // Free user memory pages,
@@ -282,44 +678,86 @@ freewalk(pagetable_t pagetable)
 void
 uvmfree(pagetable_t pagetable, uint64 sz)
 {
+  struct memacct *a;
+  int n;
+
   if(sz > 0)
     uvmunmap(pagetable, 0, PGROUNDUP(sz)/PGSIZE, 1);
-  freewalk(pagetable);
+#ifdef KPGTBL
+  // the device mappings belong to the kernel page table.
+  if(pagetable[0] & PTE_V){
+    pagetable_t l1 = (pagetable_t)PTE2PA(pagetable[0]);
+    for(int i = PX(1, UMIRROR); i < 512; i++)
+      l1[i] = 0;
+  }
+#endif
+  // disown the root page before freeing it, since it
+  // may become another process's page table at once.
+  a = acctof(pagetable);
+  OWNER(pagetable) = 0;
+  n = freewalk(pagetable);
+  if(a)
+    a->ptpages -= n;
 }
 
-// Given a parent process's page table, copy
-// its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// Given a parent process's page table, share
+// its memory with a child's page table, copy-on-write.
+// Copies the page table; the physical pages are copied
+// later by cowfault() when either side writes them.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
 int
 uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
 {
-  pte_t *pte;
+  pte_t *pte, *npte;
   uint64 pa, i;
   uint flags;
-  char *mem;
+  struct memacct *a = acctof(new), *o = acctof(old);
+
+  // the child is charged for every page it shares, so it
+  // must fit in the limits it inherited.
+  if(a && o && room(a) < o->rss + o->swapped)
+    return -1;
 
   for(i = 0; i < sz; i += PGSIZE){
+    // COW works a page at a time, so split megapages.
+    if((pte = megapte(old, i)) != 0 && demote(old, pte) < 0)
+      goto err;
     if((pte = walk(old, i, 0)) == 0)
       continue;   // page table entry hasn't been allocated
-    if((*pte & PTE_V) == 0)
+    if((*pte & (PTE_V|PTE_SWAP)) == 0)
       continue;   // physical page hasn't been allocated
+    // walk() may sleep in kalloc()'s swapout(), and while we
+    // sleep the sweep may swap this very page out; so read *pte
+    // only once the child's PTE exists.
+    if((npte = walk(new, i, 1)) == 0)
+      goto err;
+    if(*pte & PTE_SWAP){
+      // the child shares the copy in swap.
+      *npte = *pte;
+      swapdup(PTE2SLOT(*pte));
+      charge(new, 0, 0, 1);
+      continue;
+    }
+    // share the page; writable pages become read-only
+    // copy-on-write in both parent and child.  Take the
+    // child's reference first, which keeps the sweep off it.
+    if(*pte & PTE_W)
+      *pte = (*pte & ~PTE_W) | PTE_COW;
     pa = PTE2PA(*pte);
     flags = PTE_FLAGS(*pte);
-    if((mem = kalloc()) == 0)
-      goto err;
-    memmove(mem, (char*)pa, PGSIZE);
-    if(mappages(new, i, PGSIZE, (uint64)mem, flags) != 0){
-      kfree(mem);
+    kref((void*)pa);
+    if(mappages(new, i, PGSIZE, pa, flags) != 0){
+      kfree((void*)pa);
       goto err;
     }
   }
+  uvmflush(old, 0, sz);
   return 0;
 
  err:
   uvmunmap(new, 0, i / PGSIZE, 1);
+  uvmflush(old, 0, sz);
   return -1;
 }
 
@@ -336,72 +774,164 @@ uvmclear(pagetable_t pagetable, uint64 va)
   *pte &= ~PTE_U;
 }
 
-// Copy from kernel to user.
-// Copy len bytes from src to virtual address dstva in a given page table.
-// Return 0 on success, -1 on error.
-int
-copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
+// Start a cursor over pagetable's user memory, or forget
+// the cursor's cached translation.
+void
+uinit(struct ucursor *uc, pagetable_t pagetable)
 {
-  uint64 n, va0, pa0;
+  uc->pagetable = pagetable;
+  uc->start = uc->end = 0;
+}
+
+// Make uc's cached range cover user address va, faulting in a
+// lazily-allocated, swapped-out or mmap() page.  For a store,
+// also give the process its own copy of a copy-on-write page
+// and forbid read-only pages such as user text.  Returns 0, or
+// -1 if va can't be accessed.
+static int
+ucache(struct ucursor *uc, uint64 va, int write)
+{
+  uint64 va0 = PGROUNDDOWN(va);
   pte_t *pte;
 
-  while(len > 0){
-    va0 = PGROUNDDOWN(dstva);
-    if(va0 >= MAXVA)
+  if(va >= uc->start && va < uc->end && (uc->write || !write))
+    return 0;
+  if(va0 >= MAXVA)
+    return -1;
+
+  // vmfault() may sleep, and the page may be swapped out
+  // again meanwhile, so look again after each fault.
+  while((pte = walk(uc->pagetable, va0, 0)) == 0 ||
+        (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0){
+    if(vmfault(uc->pagetable, va0, !write) == 0)
       return -1;
-  
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0) {
-      if((pa0 = vmfault(pagetable, va0, 0)) == 0) {
-        return -1;
-      }
-    }
+  }
+  if(write && (*pte & PTE_COW) && cowfault(uc->pagetable, va0) == 0)
+    return -1;
+  // let vmafault() upgrade a writable mmap() page.
+  if(write && (*pte & PTE_W) == 0 && vmfault(uc->pagetable, va0, 0) == 0)
+    return -1;
 
-    pte = walk(pagetable, va0, 0);
-    // forbid copyout over read-only user text pages.
-    if((*pte & PTE_W) == 0)
+  if(megapte(uc->pagetable, va0) == pte){
+    uc->start = MEGAROUNDDOWN(va0);
+    uc->end = uc->start + MEGAPGSIZE;
+  } else {
+    uc->start = va0;
+    uc->end = va0 + PGSIZE;
+  }
+  uc->pa = PTE2PA(*pte);
+  uc->write = (*pte & PTE_W) != 0;
+  return 0;
+}
+
+#ifdef KPGTBL
+// Can the kernel reach user memory [va, va+len) of pagetable
+// directly, through the current process's kernel page table?
+// Only the caller's own memory below p->sz, and not the stack
+// guard page, which lacks only PTE_U and so doesn't stop the
+// kernel.
+static int
+udirect(pagetable_t pagetable, uint64 va, uint64 len)
+{
+  struct proc *p = myproc();
+
+  return p != 0 && pagetable == p->pagetable &&
+    va + len >= va && va + len <= p->sz &&
+    (va + len <= p->guard || va >= p->guard + PGSIZE);
+}
+#endif
+
+// Copy len bytes from src to user address dstva through uc,
+// one memmove() per page.
+// Return 0 on success, -1 on error.
+int
+ucopyout(struct ucursor *uc, uint64 dstva, char *src, uint64 len)
+{
+  uint64 n;
+
+#ifdef KPGTBL
+  if(udirect(uc->pagetable, dstva, len))
+    return ucopy((void *)dstva, src, len);
+#endif
+  while(len > 0){
+    if(ucache(uc, dstva, 1) < 0)
       return -1;
-      
-    n = PGSIZE - (dstva - va0);
+    n = uc->end - dstva;
     if(n > len)
       n = len;
-    memmove((void *)(pa0 + (dstva - va0)), src, n);
-
+    memmove((void *)(uc->pa + (dstva - uc->start)), src, n);
     len -= n;
     src += n;
-    dstva = va0 + PGSIZE;
+    dstva += n;
   }
   return 0;
 }
 
-// Copy from user to kernel.
-// Copy len bytes to dst from virtual address srcva in a given page table.
+// Copy len bytes to dst from user address srcva through uc.
 // Return 0 on success, -1 on error.
 int
-copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
+ucopyin(struct ucursor *uc, char *dst, uint64 srcva, uint64 len)
 {
-  uint64 n, va0, pa0;
+  uint64 n;
 
+#ifdef KPGTBL
+  if(udirect(uc->pagetable, srcva, len))
+    return ucopy(dst, (void *)srcva, len);
+#endif
   while(len > 0){
-    va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0) {
-      if((pa0 = vmfault(pagetable, va0, 0)) == 0) {
-        return -1;
-      }
-    }
-    n = PGSIZE - (srcva - va0);
+    if(ucache(uc, srcva, 0) < 0)
+      return -1;
+    n = uc->end - srcva;
     if(n > len)
       n = len;
-    memmove(dst, (void *)(pa0 + (srcva - va0)), n);
-
+    memmove(dst, (void *)(uc->pa + (srcva - uc->start)), n);
     len -= n;
     dst += n;
-    srcva = va0 + PGSIZE;
+    srcva += n;
   }
   return 0;
 }
 
+// Fault in user memory [va, va+len) for a later copy, which
+// may be made holding a spinlock and so can't sleep in the
+// fault.  Return 0 on success, -1 on error.
+int
+ufault(pagetable_t pagetable, uint64 va, uint64 len, int write)
+{
+  struct ucursor uc;
+  uint64 a;
+
+  uinit(&uc, pagetable);
+  for(a = PGROUNDDOWN(va); a < va + len; a += PGSIZE)
+    if(ucache(&uc, a, write) < 0)
+      return -1;
+  return 0;
+}
+
+// Copy from kernel to user.
+// Copy len bytes from src to virtual address dstva in a given page table.
+// Return 0 on success, -1 on error.
+int
+copyout(pagetable_t pagetable, uint64 dstva, char *src, uint64 len)
+{
+  struct ucursor uc;
+
+  uinit(&uc, pagetable);
+  return ucopyout(&uc, dstva, src, len);
+}
+
+// Copy from user to kernel.
+// Copy len bytes to dst from virtual address srcva in a given page table.
+// Return 0 on success, -1 on error.
+int
+copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
+{
+  struct ucursor uc;
+
+  uinit(&uc, pagetable);
+  return ucopyin(&uc, dst, srcva, len);
+}
+
 // Copy a null-terminated string from user to kernel.
 // Copy bytes to dst from virtual address srcva in a given page table,
 // until a '\0', or max.
@@ -409,19 +939,32 @@ copyin(pagetable_t pagetable, char *dst, uint64 srcva, uint64 len)
 int
 copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
 {
-  uint64 n, va0, pa0;
+  struct ucursor uc;
+  uint64 n;
   int got_null = 0;
 
+#ifdef KPGTBL
+  // the part below p->sz directly; a string running on
+  // past it, into an mmap() region, takes the slow way.
+  uint64 sz = myproc()->sz;
+  n = srcva < sz && sz - srcva < max ? sz - srcva : max;
+  if(udirect(pagetable, srcva, n)){
+    int r = ucopystr(dst, (char *)srcva, n);
+    if(r <= 0)
+      return r;
+    if(n == max)
+      return -1;
+  }
+#endif
+  uinit(&uc, pagetable);
   while(got_null == 0 && max > 0){
-    va0 = PGROUNDDOWN(srcva);
-    pa0 = walkaddr(pagetable, va0);
-    if(pa0 == 0)
+    if(ucache(&uc, srcva, 0) < 0)
       return -1;
-    n = PGSIZE - (srcva - va0);
+    n = uc.end - srcva;
     if(n > max)
       n = max;
 
-    char *p = (char *) (pa0 + (srcva - va0));
+    char *p = (char *) (uc.pa + (srcva - uc.start));
     while(n > 0){
       if(*p == '\0'){
         *dst = '\0';
@@ -436,7 +979,7 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
       dst++;
     }
 
-    srcva = va0 + PGSIZE;
+    srcva = uc.end;
   }
   if(got_null){
     return 0;
@@ -445,33 +988,177 @@ copyinstr(pagetable_t pagetable, char *dst, uint64 srcva, uint64 max)
   }
 }
 
+// Map a zeroed page at page-aligned va, which must be below sz
+// and not mapped, or a whole megapage around it if huge is set
+// and the block allows.  Returns the physical address for va,
+// or 0 if out of memory.
+static uint64
+uvmfill(pagetable_t pagetable, uint64 va, uint64 sz, int huge)
+{
+  uint64 mem;
+
+  if(huge && (mem = uvmmega(pagetable, va, sz, PTE_W|PTE_U|PTE_R)) != 0)
+    return mem;
+  mem = (uint64) kzalloc();
+  if(mem == 0)
+    return 0;
+  if (mappages(pagetable, va, PGSIZE, mem, PTE_W|PTE_U|PTE_R) != 0) {
+    kfree((void *)mem);
+    return 0;
+  }
+  return mem;
+}
+
 // allocate and map user memory if process is referencing a page
-// that was lazily allocated in sys_sbrk().
+// that was lazily allocated in sys_sbrk().  also maps up to
+// p->faultaround - 1 following pages, so that a process walking
+// through its heap takes one trap per window rather than per page.
+// reads back a page that was swapped out, and when out of memory
+// swaps out other pages to make room, unless holding a spinlock.
+// kills the process if the page would put it over its memory
+// limit, and maps no more fault-around pages than fit.
+// faults above the heap go to vmafault() for mmap() regions.
 // returns 0 if va is invalid or already mapped, or if
 // out of physical memory, and physical address if successful.
 uint64
 vmfault(pagetable_t pagetable, uint64 va, int read)
 {
-  uint64 mem;
+  uint64 mem, a;
+  pte_t *pte;
+  int r;
   struct proc *p = myproc();
 
   if (va >= p->sz)
-    return 0;
+    return vmafault(p, va, read);
   va = PGROUNDDOWN(va);
+  if((pte = walk(pagetable, va, 0)) != 0 && (*pte & PTE_SWAP)){
+    if(holdingspin())
+      return 0;
+    while((mem = swapin(pte)) == 0){
+      if(swapreclaim(1) < 0)
+        return 0;
+    }
+    p->majfaults++;
+    uvmflush(pagetable, va, PGSIZE);
+    return mem;
+  }
   if(ismapped(pagetable, va)) {
     return 0;
   }
-  mem = (uint64) kalloc();
-  if(mem == 0)
-    return 0;
-  memset((void *) mem, 0, PGSIZE);
-  if (mappages(p->pagetable, va, PGSIZE, mem, PTE_W|PTE_U|PTE_R) != 0) {
-    kfree((void *)mem);
+  if((r = uvmlimit(p)) == 0)
     return 0;
+  while((mem = uvmfill(p->pagetable, va, p->sz, !p->nohuge && r >= MEGAPGSIZE/PGSIZE)) == 0){
+    if(holdingspin() || swapreclaim(p->faultaround) < 0)
+      return 0;
+  }
+
+  // best effort: stop at the first mapped page, failure,
+  // or the memory limit.
+  for(a = va + PGSIZE; a < va + p->faultaround*PGSIZE && a < p->sz; a += PGSIZE){
+    if((r = room(&p->acct)) <= 0 || ismapped(pagetable, a) ||
+       uvmfill(p->pagetable, a, p->sz, !p->nohuge && r >= MEGAPGSIZE/PGSIZE) == 0)
+      break;
   }
+  uvmflush(pagetable, va, a - va);
   return mem;
 }
 
+// Apply madvise() advice to the caller's memory in
+// [addr, addr+len).  Returns 0, or -1 for bad arguments
+// or if MADV_WILLNEED runs out of memory or reaches the
+// memory limit.
+int
+uvmadvise(uint64 addr, uint64 len, int advice)
+{
+  struct proc *p = myproc();
+  uint64 a, end;
+  pte_t *pte;
+  int r;
+
+  switch(advice){
+  case MADV_NORMAL:
+    p->faultaround = FAULTAROUND;
+    return 0;
+  case MADV_RANDOM:
+    p->faultaround = 1;
+    return 0;
+  case MADV_SEQUENTIAL:
+    p->faultaround = FAULTMAX;
+    return 0;
+  case MADV_HUGEPAGE:
+    p->nohuge = 0;
+    return 0;
+  case MADV_NOHUGEPAGE:
+    p->nohuge = 1;
+    return 0;
+  case MADV_WILLNEED:
+  case MADV_DONTNEED:
+    break;
+  default:
+    return -1;
+  }
+
+  if(addr % PGSIZE != 0 || addr + len < addr || addr + len > p->sz)
+    return -1;
+  // only the heap, above the stack exec() set up, may be dropped;
+  // text and data would come back as zero-fill.
+  if(advice == MADV_DONTNEED && addr < p->guard + (USERSTACK+1)*PGSIZE)
+    return -1;
+  end = PGROUNDUP(addr + len);
+  for(a = addr; a < end; a += PGSIZE){
+    pte = walk(p->pagetable, a, 0);
+    if(advice == MADV_WILLNEED){
+      if(pte && (*pte & PTE_SWAP)){
+        if(swapin(pte) == 0)
+          return -1;
+        continue;
+      }
+      if(pte && (*pte & PTE_V))
+        continue;
+      if((r = room(&p->acct)) <= 0)
+        return -1;
+      if(uvmfill(p->pagetable, a, p->sz, !p->nohuge && r >= MEGAPGSIZE/PGSIZE) == 0)
+        return -1;
+    } else if(pte && (*pte & (PTE_V|PTE_SWAP))){
+      uvmunmap(p->pagetable, a, 1, 1);
+    }
+  }
+  uvmflush(p->pagetable, addr, end - addr);
+  return 0;
+}
+
+// Handle a store to va on a copy-on-write page: copy the page,
+// or if no other process shares it any more, just make it
+// writable again.  Returns the new physical address, or 0 if
+// va is not a COW page or there is no memory for the copy.
+uint64
+cowfault(pagetable_t pagetable, uint64 va)
+{
+  pte_t *pte;
+  uint64 pa;
+  uint flags;
+  char *mem;
+
+  if(va >= MAXVA)
+    return 0;
+  pte = walk(pagetable, va, 0);
+  if(pte == 0 || (*pte & (PTE_V|PTE_U|PTE_COW)) != (PTE_V|PTE_U|PTE_COW))
+    return 0;
+  pa = PTE2PA(*pte);
+  flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+  if(krefcnt((void*)pa) == 1){
+    *pte = PA2PTE(pa) | flags;
+  } else {
+    if((mem = kalloc()) == 0)
+      return 0;
+    memmove(mem, (char*)pa, PGSIZE);
+    *pte = PA2PTE(mem) | flags;
+    kfree((void*)pa);
+  }
+  uvmflush(pagetable, va, PGSIZE);
+  return PTE2PA(*pte);
+}
+
 int
 ismapped(pagetable_t pagetable, uint64 va)
 {
@@ -479,7 +1166,7 @@ ismapped(pagetable_t pagetable, uint64 va)
   if (pte == 0) {
     return 0;
   }
-  if (*pte & PTE_V){
+  if (*pte & (PTE_V|PTE_SWAP)){
     return 1;
   }
   return 0;
@@ -0,0 +1,62 @@
+// ps: per-process memory usage, largest resident set first.
+// SIZE is the heap as sbrk() reserved it, touched or not; RSS is
+// what is actually resident, PEAK its high-water mark, PT the
+// page-table pages, SWAP the pages out in swap, LIMIT the
+// process's own memory limit, and GROUP its memory group.  Sizes
+// are in KiB.
+//
+// usage: ps
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/meminfo.h"
+#include "user/user.h"
+
+#define KB(pages) ((int)(pages) * 4)
+
+static char *states[] = { "unused", "used", "sleep", "runble", "run", "zombie" };
+
+struct minfo mi[NPROC];
+
+int main(int argc, char *argv[]) {
+    int n, rss = 0, pt = 0, swapped = 0;
+
+    if ((n = getminfo(mi, NPROC)) < 0) {
+        printf("ps: getminfo failed\n");
+        exit(1);
+    }
+
+    // insertion sort by rss, largest first.
+    for (int i = 1; i < n; i++) {
+        struct minfo m = mi[i];
+        int j;
+        for (j = i; j > 0 && mi[j - 1].rss < m.rss; j--)
+            mi[j] = mi[j - 1];
+        mi[j] = m;
+    }
+
+    printf("PID\tSTATE\tSIZE\tRSS\tPEAK\tPT\tSWAP\tLIMIT\tGROUP\tFAULTS\tMAJFLT\tNAME\n");
+    for (int i = 0; i < n; i++) {
+        struct minfo *m = &mi[i];
+        printf("%d\t%s\t%d\t%d\t%d\t%d\t%d\t", m->pid,
+               m->state >= 0 && m->state < 6 ? states[m->state] : "???",
+               (int)(m->sz / 1024), KB(m->rss), KB(m->peak), KB(m->ptpages),
+               KB(m->swapped));
+        if (m->limit)
+            printf("%d\t", KB(m->limit));
+        else
+            printf("-\t");
+        if (m->group >= 0)
+            printf("%d\t", m->group);
+        else
+            printf("-\t");
+        printf("%d\t%d\t%s\n", m->faults, m->majfaults, m->name);
+        rss += m->rss;
+        pt += m->ptpages;
+        swapped += m->swapped;
+    }
+    printf("%d processes, %d KB resident, %d KB page tables, %d KB swapped\n",
+           n, KB(rss), KB(pt), KB(swapped));
+    exit(0);
+}
@@ -0,0 +1,110 @@
+// Page Allocator Scaling Benchmark
+// Workers repeatedly fork a child that exits at once and grow and
+// shrink their heap with sbrk(), so nearly all their time goes to
+// kalloc()/kfree(). Run it under make qemu CPUS=1, CPUS=2, ...
+// CPUS=8 and compare the page rate.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NWORKERS 4              // Default concurrent workers
+#define MAXWORKERS 16
+#define SBRK_PAGES 64           // Pages per sbrk() grow/shrink
+#define TEST_DURATION 50        // Run for this many ticks
+#define PGSIZE 4096
+
+// Allocate and free pages until the deadline; return the
+// number of pages sbrk() allocated plus the forks done.
+void worker(int deadline, int fd) {
+    int counts[2] = {0, 0};     // sbrk pages, forks
+
+    while (uptime() < deadline) {
+        char *p = sbrk(SBRK_PAGES * PGSIZE);
+        if (p == SBRK_ERROR)
+            break;
+        for (int i = 0; i < SBRK_PAGES; i++)
+            p[i * PGSIZE] = 1;
+        sbrk(-SBRK_PAGES * PGSIZE);
+        counts[0] += SBRK_PAGES;
+
+        int pid = fork();
+        if (pid < 0)
+            break;
+        if (pid == 0)
+            exit(0);
+        wait(0);
+        counts[1]++;
+    }
+    write(fd, counts, sizeof(counts));
+    exit(0);
+}
+
+int main(int argc, char *argv[]) {
+    int nworkers = NWORKERS;
+    int results[2];
+    int pages = 0, forks = 0;
+    uint64 freebefore, allocbefore, freeafter, allocafter;
+
+    if (argc > 1)
+        nworkers = atoi(argv[1]);
+    if (nworkers < 1 || nworkers > MAXWORKERS) {
+        printf("usage: test_allocscale [nworkers 1-%d]\n", MAXWORKERS);
+        exit(1);
+    }
+
+    printf("========================================\n");
+    printf("  Page Allocator Scaling Benchmark\n");
+    printf("========================================\n\n");
+    printf("Configuration:\n");
+    printf("  Workers:             %d\n", nworkers);
+    printf("  Pages per sbrk:      %d\n", SBRK_PAGES);
+    printf("  Test duration:       %d ticks\n\n", TEST_DURATION);
+
+    memstat(&freebefore, &allocbefore, 0, 0);
+    if (pipe(results) < 0) {
+        printf("Error: pipe creation failed\n");
+        exit(1);
+    }
+
+    int deadline = uptime() + TEST_DURATION;
+    for (int i = 0; i < nworkers; i++) {
+        int pid = fork();
+        if (pid < 0) {
+            printf("Error: fork failed\n");
+            exit(1);
+        }
+        if (pid == 0) {
+            close(results[0]);
+            worker(deadline, results[1]);
+        }
+    }
+    close(results[1]);
+
+    for (int i = 0; i < nworkers; i++) {
+        int counts[2];
+        if (read(results[0], counts, sizeof(counts)) == sizeof(counts)) {
+            pages += counts[0];
+            forks += counts[1];
+        }
+        wait(0);
+    }
+    close(results[0]);
+    memstat(&freeafter, &allocafter, 0, 0);
+
+    printf("Results:\n");
+    printf("  sbrk pages:          %d\n", pages);
+    printf("  forks:               %d\n", forks);
+    printf("  kalloc() calls:      %d\n", (int)(allocafter - allocbefore));
+    printf("  Allocations per tick: %d\n\n", (int)((allocafter - allocbefore) / TEST_DURATION));
+
+    // Every page the workers took should be back.
+    printf("Free pages before/after: %d/%d\n", (int)freebefore, (int)freeafter);
+    if (freeafter == freebefore)
+        printf("Result: PASSED\n\n");
+    else
+        printf("Result: FAILED (free count drifted)\n\n");
+    printf("Compare Allocations per tick across CPUS=1..8 runs.\n");
+
+    exit(0);
+}
@@ -0,0 +1,125 @@
+// User-Copy Benchmark
+// Times a 1 MiB transfer through a pipe and a 1 MiB file read, with
+// small and page-sized buffers, then checks readv()/writev() gather
+// and scatter. The kernel copies pipe data a span at a time and
+// reuses the last page translation within a call.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/uio.h"
+#include "user/user.h"
+
+#define TOTAL (1024 * 1024)
+#define NPASSES 4
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+char *path = "copybench";
+char buf[4096];
+
+void report(char *label, int bufsize, uint64 cycles) {
+    int ms = (int)(cycles / CYCLES_PER_US / 1000 / NPASSES);
+    int kbps = ms > 0 ? 1024 * 1000 / ms : 0;
+    printf("  %s %d B:\t%d ms/MiB\t%d KB/s\n", label, bufsize, ms, kbps);
+}
+
+// Send TOTAL bytes through a pipe to a child NPASSES times.
+uint64 pipe_bench(int bufsize) {
+    uint64 start = rdtime();
+
+    for (int pass = 0; pass < NPASSES; pass++) {
+        int fds[2];
+        if (pipe(fds) < 0) {
+            printf("Error: pipe creation failed\n");
+            exit(1);
+        }
+        if (fork() == 0) {
+            close(fds[1]);
+            while (read(fds[0], buf, bufsize) > 0)
+                ;
+            exit(0);
+        }
+        close(fds[0]);
+        for (int n = 0; n < TOTAL; n += bufsize)
+            write(fds[1], buf, bufsize);
+        close(fds[1]);
+        wait(0);
+    }
+    return rdtime() - start;
+}
+
+// Read TOTAL bytes of the file NPASSES times. Files are
+// smaller than 1 MiB (MAXFILE blocks), so start over at the end.
+uint64 file_bench(int bufsize) {
+    uint64 start = rdtime();
+
+    for (int pass = 0; pass < NPASSES; pass++) {
+        int fd = open(path, O_RDONLY);
+        for (int n = 0; n < TOTAL; ) {
+            int r = read(fd, buf, bufsize);
+            if (r <= 0) {
+                close(fd);
+                fd = open(path, O_RDONLY);
+                continue;
+            }
+            n += r;
+        }
+        close(fd);
+    }
+    return rdtime() - start;
+}
+
+int main(int argc, char *argv[]) {
+    int sizes[] = {64, 512, 4096};
+    int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+
+    printf("========================================\n");
+    printf("  User-Copy Benchmark\n");
+    printf("========================================\n\n");
+
+    // As big a file as xv6 allows.
+    int fd = open(path, O_CREATE | O_TRUNC | O_WRONLY);
+    if (fd < 0) {
+        printf("Error: cannot create %s\n", path);
+        exit(1);
+    }
+    for (int i = 0; i < sizeof(buf); i++)
+        buf[i] = i;
+    int size = 0;
+    while (write(fd, buf, sizeof(buf)) == sizeof(buf))
+        size += sizeof(buf);
+    close(fd);
+    if (size == 0) {
+        printf("Error: cannot write %s\n", path);
+        exit(1);
+    }
+
+    printf("Pipe, 1 MiB per pass:\n");
+    for (int i = 0; i < nsizes; i++)
+        report("pipe", sizes[i], pipe_bench(sizes[i]));
+    printf("\nFile read, 1 MiB per pass:\n");
+    for (int i = 0; i < nsizes; i++)
+        report("file", sizes[i], file_bench(sizes[i]));
+
+    printf("\nTest: writev() gathers, readv() scatters\n");
+    char a[3] = "ab", b[5] = "cdef", c[8], d[8];
+    struct iovec out[2] = {{a, 2}, {b, 4}};
+    struct iovec in[2] = {{c, 3}, {d, 3}};
+    int p[2];
+    pipe(p);
+    int ok = writev(p[1], out, 2) == 6;
+    close(p[1]);
+    // a pipe read returns what is there, so the first iovec
+    // takes 3 bytes and the second the other 3.
+    ok = ok && readv(p[0], in, 2) == 6;
+    close(p[0]);
+    ok = ok && memcmp(c, "abc", 3) == 0 && memcmp(d, "def", 3) == 0;
+    ok = ok && readv(0, in, UIO_MAXIOV + 1) < 0;
+    printf(ok ? "  Result: PASSED\n\n" : "  Result: FAILED\n\n");
+
+    unlink(path);
+    printf("========================================\n");
+    printf("  User-Copy Benchmark Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
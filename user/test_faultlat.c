@@ -0,0 +1,82 @@
+// Page Fault Latency Benchmark
+// Times each first touch of a lazily allocated sbrk() page. The
+// first KZPOOL faults after a pause can take pages that idle CPUs
+// have already zeroed; later ones must zero the page themselves.
+// Build with make DEBUG=1 to see the cost of junk-filling too.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define NPAGES (2 * KZPOOL)     // Pages faulted per round
+#define PGSIZE 4096
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+uint64 samples[NPAGES];
+
+void sort(uint64 *a, int n) {
+    for (int i = 1; i < n; i++) {
+        uint64 v = a[i];
+        int j = i - 1;
+        while (j >= 0 && a[j] > v) {
+            a[j + 1] = a[j];
+            j--;
+        }
+        a[j + 1] = v;
+    }
+}
+
+// Print the mean and median of samples[lo..hi), in cycles
+// since one fault takes well under a microsecond on fast hosts.
+void report(char *name, int lo, int hi) {
+    uint64 sum = 0;
+    for (int i = lo; i < hi; i++)
+        sum += samples[i];
+    int mean = (int)(sum / (hi - lo));
+    sort(samples + lo, hi - lo);
+    printf("  %s mean %d cycles (%d us), median %d cycles\n", name,
+           mean, mean / CYCLES_PER_US, (int)samples[lo + (hi - lo) / 2]);
+}
+
+// Fault in NPAGES fresh pages, timing each, then free them.
+int fault_round(void) {
+    char *p = sbrklazy(NPAGES * PGSIZE);
+    if (p == SBRK_ERROR)
+        return -1;
+    for (int i = 0; i < NPAGES; i++) {
+        uint64 t0 = rdtime();
+        p[i * PGSIZE] = 1;
+        samples[i] = rdtime() - t0;
+    }
+    sbrk(-NPAGES * PGSIZE);
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    printf("========================================\n");
+    printf("  Page Fault Latency Benchmark\n");
+    printf("========================================\n\n");
+    printf("Configuration:\n");
+    printf("  Pages per round:     %d\n", NPAGES);
+    printf("  Pre-zeroed pool:     %d pages\n\n", KZPOOL);
+
+    // Round 1: give idle CPUs time to fill the pool first.
+    pause(10);
+    printf("Round 1: after an idle pause\n");
+    if (fault_round() < 0) {
+        printf("Error: sbrk failed\n");
+        exit(1);
+    }
+    report("first pages: ", 0, KZPOOL);
+    report("later pages: ", KZPOOL, NPAGES);
+
+    // Round 2: straight away, before the pool can refill.
+    printf("Round 2: back to back\n");
+    fault_round();
+    report("all pages:   ", 0, NPAGES);
+
+    printf("\nPooled first pages should fault faster than the rest.\n");
+    printf("Compare with a make DEBUG=1 kernel for the junk-fill cost.\n");
+    exit(0);
+}
@@ -0,0 +1,91 @@
+// Fork Benchmark for Copy-on-Write fork
+// Times fork+exec and fork+exit from a process with a large heap,
+// with the child writing 0, some, or all of the heap pages, and
+// counts the pages allocated per fork. With copy-on-write a child
+// that execs or exits right away copies only its page tables.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define HEAP_PAGES 256          // Parent heap shared with each child
+#define NFORKS 50               // Forks timed per case
+#define PGSIZE 4096
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+char *heap;
+
+// Fork NFORKS children that write the first touch heap pages
+// (or exec themselves if touch < 0) and report the average.
+void trial(char *name, int touch) {
+    uint64 free0, alloc0, free1, alloc1;
+    uint64 start = rdtime();
+
+    memstat(&free0, &alloc0, 0, 0);
+    for (int i = 0; i < NFORKS; i++) {
+        int pid = fork();
+        if (pid < 0) {
+            printf("Error: fork failed\n");
+            exit(1);
+        }
+        if (pid == 0) {
+            if (touch < 0) {
+                char *argv[] = { "test_forkbench", "child", 0 };
+                exec("test_forkbench", argv);
+                exit(1);
+            }
+            for (int j = 0; j < touch; j++)
+                heap[j * PGSIZE] = j;
+            exit(0);
+        }
+        wait(0);
+    }
+    memstat(&free1, &alloc1, 0, 0);
+    uint64 per = (rdtime() - start) / NFORKS;
+    printf("  %s %d us/fork, %d pages allocated/fork\n", name,
+           (int)(per / CYCLES_PER_US), (int)((alloc1 - alloc0) / NFORKS));
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1 && strcmp(argv[1], "child") == 0)
+        exit(0);
+
+    printf("========================================\n");
+    printf("  Copy-on-Write Fork Benchmark\n");
+    printf("========================================\n\n");
+    printf("Configuration:\n");
+    printf("  Parent heap:         %d pages\n", HEAP_PAGES);
+    printf("  Forks per case:      %d\n\n", NFORKS);
+
+    heap = sbrk(HEAP_PAGES * PGSIZE);
+    if (heap == SBRK_ERROR) {
+        printf("Error: sbrk failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < HEAP_PAGES; i++)
+        heap[i * PGSIZE] = 1;
+
+    // Test 1: a child's write must not show in the parent.
+    printf("Test 1: Child writes stay private\n");
+    int pid = fork();
+    if (pid == 0) {
+        heap[0] = 42;
+        exit(heap[0] == 42 ? 0 : 1);
+    }
+    int status;
+    wait(&status);
+    if (status == 0 && heap[0] == 1)
+        printf("  Result: PASSED\n\n");
+    else
+        printf("  Result: FAILED\n\n");
+
+    // Test 2: the cost of fork by how much the child writes.
+    printf("Test 2: Fork cost\n");
+    trial("fork+exec:             ", -1);
+    trial("fork+exit:             ", 0);
+    trial("fork+touch 16 pages:   ", 16);
+    trial("fork+touch all pages:  ", HEAP_PAGES);
+    printf("\nOnly touched pages should be copied.\n");
+
+    exit(0);
+}
@@ -0,0 +1,102 @@
+// Wakeup Latency Test for the Lottery Scheduler
+// Mixes CPU-bound spinners with a pipe ping-pong pair and reports
+// round-trip latency percentiles. With compensation tickets the
+// I/O-bound pair, which blocks after using a sliver of each
+// quantum, should win the lottery promptly when it wakes.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NSPIN 4                 // CPU-bound competitors
+#define NSAMPLES 200            // Round trips measured
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+uint64 samples[NSAMPLES];
+
+void sort(uint64 *a, int n) {
+    for (int i = 1; i < n; i++) {
+        uint64 v = a[i];
+        int j = i - 1;
+        while (j >= 0 && a[j] > v) {
+            a[j + 1] = a[j];
+            j--;
+        }
+        a[j + 1] = v;
+    }
+}
+
+void report(char *name, int pct) {
+    int i = (NSAMPLES * pct) / 100;
+    if (i >= NSAMPLES)
+        i = NSAMPLES - 1;
+    printf("  %s %d us\n", name, (int)(samples[i] / CYCLES_PER_US));
+}
+
+int main(int argc, char *argv[]) {
+    int spinners[NSPIN];
+    int ping[2], pong[2];
+    char c = 'x';
+
+    printf("========================================\n");
+    printf("  Wakeup Latency Test\n");
+    printf("========================================\n\n");
+    printf("Configuration:\n");
+    printf("  CPU-bound spinners:  %d (10 tickets each)\n", NSPIN);
+    printf("  Ping-pong pair:      10 tickets each\n");
+    printf("  Round trips timed:   %d\n\n", NSAMPLES);
+
+    for (int i = 0; i < NSPIN; i++) {
+        spinners[i] = fork();
+        if (spinners[i] < 0) {
+            printf("Error: fork failed\n");
+            exit(1);
+        }
+        if (spinners[i] == 0) {
+            volatile int k = 0;
+            for (;;)
+                k++;
+        }
+    }
+
+    if (pipe(ping) < 0 || pipe(pong) < 0) {
+        printf("Error: pipe creation failed\n");
+        exit(1);
+    }
+    int echo = fork();
+    if (echo == 0) {
+        close(ping[1]);
+        close(pong[0]);
+        while (read(ping[0], &c, 1) == 1)
+            write(pong[1], &c, 1);
+        exit(0);
+    }
+    close(ping[0]);
+    close(pong[1]);
+
+    for (int i = 0; i < NSAMPLES; i++) {
+        uint64 t0 = rdtime();
+        write(ping[1], &c, 1);
+        read(pong[0], &c, 1);
+        samples[i] = rdtime() - t0;
+    }
+    close(ping[1]);
+    close(pong[0]);
+
+    for (int i = 0; i < NSPIN; i++)
+        kill(spinners[i]);
+    while (wait(0) > 0)
+        ;
+
+    sort(samples, NSAMPLES);
+    printf("Round-trip latency:\n");
+    report("p50:", 50);
+    report("p90:", 90);
+    report("p99:", 99);
+    report("max:", 100);
+
+    printf("\n========================================\n");
+    printf("  Latency Test Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
@@ -4,16 +4,21 @@
 
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/sched.h"
+#include "kernel/mman.h"
 #include "user/user.h"
 
 #define TEST_DURATION 200       // Run for this many ticks
 #define WORK_UNITS 50000        // Work per measurement cycle
 #define HIGH_TICKETS 80         // "Rich" process tickets
 #define LOW_TICKETS 20          // "Poor" process tickets
+#define TRIALS 5                // Short runs per policy for the variance test
+#define TRIAL_DURATION 40       // Ticks per short run
 
-// Shared memory for results (using pipe for IPC)
-int pipe_high[2];
-int pipe_low[2];
+// Results written by the children: work_completed,
+// actual_duration, tickets.  Shared with them by fork().
+int *results_high;
+int *results_low;
 
 // Do a chunk of CPU-bound work
 int do_work_chunk(void) {
@@ -25,7 +30,7 @@ int do_work_chunk(void) {
 }
 
 // Child process: count how many work units completed during test period
-void child_process(int tickets, int *result_pipe) {
+void child_process(int tickets, int *results, int duration) {
     settickets(tickets);
     
     int start_time = uptime();
@@ -33,7 +38,7 @@ void child_process(int tickets, int *result_pipe) {
     
     // Keep working until test duration is over
     // Both processes compete for CPU during this time
-    while (uptime() - start_time < TEST_DURATION) {
+    while (uptime() - start_time < duration) {
         do_work_chunk();
         work_completed++;
     }
@@ -41,14 +46,61 @@ void child_process(int tickets, int *result_pipe) {
     int end_time = uptime();
     int actual_duration = end_time - start_time;
     
-    // Send results: work_completed, actual_duration, tickets
-    int results[3] = {work_completed, actual_duration, tickets};
-    write(result_pipe[1], results, sizeof(results));
-    close(result_pipe[1]);
+    // Publish results: work_completed, actual_duration, tickets
+    results[0] = work_completed;
+    results[1] = actual_duration;
+    results[2] = tickets;
     
     exit(0);
 }
 
+// Run one short high-vs-low trial and return the high-ticket
+// process's share of the work done, in percent (or -1 on error).
+int share_trial(void) {
+    int *rh = results_high, *rl = results_low;
+
+    rh[0] = rl[0] = 0;
+    if (fork() == 0)
+        child_process(HIGH_TICKETS, rh, TRIAL_DURATION);
+    if (fork() == 0)
+        child_process(LOW_TICKETS, rl, TRIAL_DURATION);
+    wait(0);
+    wait(0);
+    if (rh[0] + rl[0] == 0)
+        return -1;
+    return (rh[0] * 100) / (rh[0] + rl[0]);
+}
+
+// Run TRIALS short trials under policy and report the mean and
+// variance of the high-ticket share.  Returns the variance.
+int policy_variance(int policy, char *name) {
+    int shares[TRIALS];
+    int sum = 0, var = 0, n = 0;
+
+    setsched(policy);
+    for (int t = 0; t < TRIALS; t++) {
+        int s = share_trial();
+        if (s >= 0)
+            shares[n++] = s;
+    }
+    if (n == 0) {
+        printf("  %s: no trials completed\n", name);
+        return -1;
+    }
+    for (int i = 0; i < n; i++)
+        sum += shares[i];
+    int mean = sum / n;
+    for (int i = 0; i < n; i++)
+        var += (shares[i] - mean) * (shares[i] - mean);
+    var /= n;
+
+    printf("  %s shares:", name);
+    for (int i = 0; i < n; i++)
+        printf(" %d%%", shares[i]);
+    printf("\n    mean %d%%, variance %d\n", mean, var);
+    return var;
+}
+
 int main(int argc, char *argv[]) {
     printf("========================================\n");
     printf("  Lottery Scheduler Fairness Test\n");
@@ -66,11 +118,14 @@ int main(int argc, char *argv[]) {
     printf("  With %d:%d tickets ratio, the high-ticket process\n", HIGH_TICKETS, LOW_TICKETS);
     printf("  should complete ~%dx more work in the same time.\n\n", HIGH_TICKETS / LOW_TICKETS);
     
-    // Create pipes for receiving results
-    if (pipe(pipe_high) < 0 || pipe(pipe_low) < 0) {
-        printf("Error: pipe creation failed\n");
+    // Map a page the children can write their results into
+    int *shared = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+    if (shared == MAP_FAILED) {
+        printf("Error: mmap failed\n");
         exit(1);
     }
+    results_high = shared;
+    results_low = shared + 3;
     
     printf("Starting concurrent test...\n");
     printf("Both processes will run simultaneously for %d ticks.\n\n", TEST_DURATION);
@@ -82,10 +137,7 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
     if (pid_high == 0) {
-        close(pipe_high[0]);
-        close(pipe_low[0]);
-        close(pipe_low[1]);
-        child_process(HIGH_TICKETS, pipe_high);
+        child_process(HIGH_TICKETS, results_high, TEST_DURATION);
     }
     
     // Create low-ticket process IMMEDIATELY after
@@ -95,26 +147,12 @@ int main(int argc, char *argv[]) {
         exit(1);
     }
     if (pid_low == 0) {
-        close(pipe_low[0]);
-        close(pipe_high[0]);
-        close(pipe_high[1]);
-        child_process(LOW_TICKETS, pipe_low);
+        child_process(LOW_TICKETS, results_low, TEST_DURATION);
     }
     
-    // Parent closes write ends and waits
-    close(pipe_high[1]);
-    close(pipe_low[1]);
-    
     wait(0);
     wait(0);
     
-    // Read results from pipes
-    int results_high[3], results_low[3];
-    read(pipe_high[0], results_high, sizeof(results_high));
-    read(pipe_low[0], results_low, sizeof(results_low));
-    close(pipe_high[0]);
-    close(pipe_low[0]);
-    
     int work_high = results_high[0];
     int time_high = results_high[1];
     int tickets_high = results_high[2];
@@ -202,6 +240,25 @@ int main(int argc, char *argv[]) {
         printf("Error: No work completed. Increase TEST_DURATION.\n");
     }
     
+    // Compare how steadily each policy delivers the 80% share.
+    printf("\n========================================\n");
+    printf("  LOTTERY vs STRIDE SHARE VARIANCE\n");
+    printf("========================================\n\n");
+    printf("  %d trials of %d ticks each, expected share %d%%\n\n",
+           TRIALS, TRIAL_DURATION, (HIGH_TICKETS * 100) / (HIGH_TICKETS + LOW_TICKETS));
+
+    int oldpolicy = setsched(SCHED_LOTTERY);
+    int var_lottery = policy_variance(SCHED_LOTTERY, "Lottery");
+    int var_stride = policy_variance(SCHED_STRIDE, "Stride ");
+    setsched(oldpolicy);
+
+    if (var_lottery >= 0 && var_stride >= 0) {
+        if (var_stride <= var_lottery)
+            printf("\n  Stride scheduling gave the steadier share.\n");
+        else
+            printf("\n  Lottery gave the steadier share this run.\n");
+    }
+
     printf("\n========================================\n");
     printf("  Lottery Scheduler Test Complete\n");
     printf("========================================\n");
@@ -0,0 +1,88 @@
+// Megapage Heap Benchmark
+// Streams over a 32 MiB sbrk() heap, which the kernel backs with
+// 2 MiB megapages where it can, then forks once so the kernel has
+// to split them into 4 KiB pages for copy-on-write, and streams
+// again. The second pass needs 512 times as many TLB entries.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define HEAP_MB 32
+#define MEGA (2 * 1024 * 1024)
+#define NPASSES 4               // Passes over the heap per timing
+#define STRIDE 64               // Bytes between loads (a cache line)
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+char *heap;
+
+// Read every STRIDE-th byte of the heap NPASSES times and
+// return the elapsed timer cycles.
+uint64 stream(void) {
+    volatile char sink = 0;
+    uint64 start = rdtime();
+
+    for (int pass = 0; pass < NPASSES; pass++)
+        for (int i = 0; i < HEAP_MB * 1024 * 1024; i += STRIDE)
+            sink += heap[i];
+    return rdtime() - start;
+}
+
+int main(int argc, char *argv[]) {
+    int hold[2];
+
+    printf("========================================\n");
+    printf("  Megapage Heap Benchmark\n");
+    printf("========================================\n\n");
+    printf("Configuration:\n");
+    printf("  Heap:                %d MB\n", HEAP_MB);
+    printf("  Passes per timing:   %d\n\n", NPASSES);
+
+    // Allocate an extra megapage so an aligned 32 MiB fits.
+    char *p = sbrk(HEAP_MB * 1024 * 1024 + MEGA);
+    if (p == SBRK_ERROR) {
+        printf("Error: sbrk failed\n");
+        exit(1);
+    }
+    heap = (char *)(((uint64)p + MEGA - 1) & ~(uint64)(MEGA - 1));
+    for (int i = 0; i < HEAP_MB * 1024 * 1024; i += 4096)
+        heap[i] = i >> 12;
+
+    stream();   // warm up
+    uint64 mega = stream();
+
+    // A child makes fork() split the parent's megapages.
+    if (pipe(hold) < 0) {
+        printf("Error: pipe creation failed\n");
+        exit(1);
+    }
+    int pid = fork();
+    if (pid == 0) {
+        char c;
+        close(hold[1]);
+        read(hold[0], &c, 1);
+        exit(0);
+    }
+    close(hold[0]);
+    stream();   // warm up
+    uint64 small = stream();
+    close(hold[1]);
+    wait(0);
+
+    printf("Results:\n");
+    printf("  2 MiB pages:         %d ms\n", (int)(mega / CYCLES_PER_US / 1000));
+    printf("  4 KiB pages:         %d ms\n", (int)(small / CYCLES_PER_US / 1000));
+    if (mega > 0) {
+        int x100 = (int)(small * 100 / mega);
+        printf("  4 KiB / 2 MiB time:  %d.%d%d\n\n", x100 / 100, (x100 / 10) % 10, x100 % 10);
+    }
+
+    // Test: the data survived the split.
+    int ok = 1;
+    for (int i = 0; i < HEAP_MB * 1024 * 1024; i += 4096)
+        if (heap[i] != (char)(i >> 12))
+            ok = 0;
+    printf("Data intact after split: %s\n", ok ? "PASSED" : "FAILED");
+    printf("Under qemu the gap is small; on hardware it reflects TLB reach.\n");
+    exit(0);
+}
@@ -0,0 +1,148 @@
+// Memory Limit Test
+// Checks per-process and group page limits: an eager sbrk() past the
+// limit fails, touching a lazy heap past it kills the process with
+// exit status EXIT_MEMLIMIT, a group's members share one limit, and
+// fork() fails when the child's share wouldn't fit in its group,
+// a process already over its limit can't grow at all, and a limit
+// can only be lowered.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/mman.h"
+#include "kernel/meminfo.h"
+#include "user/user.h"
+
+#define LIMIT 128               // pages
+
+void result(int ok) {
+    printf(ok ? "  Result: PASSED\n\n" : "  Result: FAILED\n\n");
+}
+
+// Grow a lazy heap of n pages and touch all of it.
+void touch(int n) {
+    char *heap = sbrklazy(n * 4096);
+    if (heap == SBRK_ERROR) {
+        printf("  sbrklazy failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < n; i++)
+        heap[i * 4096] = 1;
+}
+
+// Run f in a child and return its exit status.
+int child(void (*f)(void)) {
+    int pid, status;
+
+    if ((pid = fork()) < 0) {
+        printf("  fork failed\n");
+        exit(1);
+    }
+    if (pid == 0) {
+        f();
+        exit(0);
+    }
+    wait(&status);
+    return status;
+}
+
+void eager(void) {
+    setmemlimit(LIMIT);
+    exit(sbrk(2 * LIMIT * 4096) == SBRK_ERROR ? 0 : 1);
+}
+
+void lazy(void) {
+    setmemlimit(LIMIT);
+    touch(2 * LIMIT);
+}
+
+void group(void) {
+    int ready[2], hold[2];
+    char c;
+
+    if (mkmemgroup(LIMIT) < 0) {
+        printf("  mkmemgroup failed\n");
+        exit(1);
+    }
+    // each half fits on its own; together they don't, so this
+    // process dies touching its half while the child holds its own.
+    pipe(ready);
+    pipe(hold);
+    if (fork() == 0) {
+        close(hold[1]);
+        touch(LIMIT / 2);
+        write(ready[1], "x", 1);
+        read(hold[0], &c, 1);   // until the parent exits
+        exit(0);
+    }
+    close(hold[0]);
+    read(ready[0], &c, 1);
+    touch(LIMIT / 2);
+    exit(0);
+}
+
+// over the limit after lowering it below the resident set.
+void over(void) {
+    touch(LIMIT / 2);
+    setmemlimit(LIMIT / 4);
+    if (sbrk(4096) != SBRK_ERROR)
+        exit(1);
+    exit(mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0) ==
+         MAP_FAILED ? 0 : 2);
+}
+
+// the limit from the parent can be lowered but not raised or
+// removed.
+void raiselimit(void) {
+    if (setmemlimit(LIMIT * 2) == 0 || setmemlimit(0) == 0)
+        exit(1);
+    exit(setmemlimit(LIMIT / 2) == 0 ? 0 : 2);
+}
+
+void forkfail(void) {
+    mkmemgroup(LIMIT);
+    touch(LIMIT * 2 / 3);
+    exit(fork() < 0 ? 0 : 1);
+}
+
+int main(int argc, char *argv[]) {
+    int status;
+
+    printf("========================================\n");
+    printf("  Memory Limit Test\n");
+    printf("========================================\n\n");
+
+    // count 4 KiB pages, not megapages.
+    madvise(0, 0, MADV_NOHUGEPAGE);
+
+    printf("Test 1: an eager sbrk() past the limit fails\n");
+    result(child(eager) == 0);
+
+    printf("Test 2: touching a lazy heap past the limit kills\n");
+    status = child(lazy);
+    printf("  exit status %d\n", status);
+    result(status == EXIT_MEMLIMIT);
+
+    printf("Test 3: a group's members share its limit\n");
+    status = child(group);
+    printf("  exit status %d\n", status);
+    result(status == EXIT_MEMLIMIT);
+
+    printf("Test 4: fork() fails if the child won't fit\n");
+    result(child(forkfail) == 0);
+
+    printf("Test 5: a process over its limit can't sbrk() or mmap()\n");
+    result(child(over) == 0);
+
+    printf("Test 6: an inherited limit can't be raised or removed\n");
+    if (fork() == 0) {
+        setmemlimit(LIMIT);
+        exit(child(raiselimit));
+    }
+    wait(&status);
+    result(status == 0);
+
+    printf("========================================\n");
+    printf("  Memory Limit Test Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
@@ -0,0 +1,180 @@
+// mmap() Test and Benchmark
+// Maps a 256 KB file and checks private and shared mappings,
+// partial munmap(), sharing with a forked child and between
+// separate mappings and read()/write(), then times summing the
+// file with read() against reading the mapping.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "kernel/mman.h"
+#include "user/user.h"
+
+#define FILE_KB 256
+#define FSIZE (FILE_KB * 1024)
+#define NPASSES 8
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+char *path = "mmapfile";
+char buf[4096];
+
+// Expected byte at offset i.
+char pattern(int i) {
+    return 'a' + (i / 4096 + i) % 26;
+}
+
+void result(int ok) {
+    printf(ok ? "  Result: PASSED\n\n" : "  Result: FAILED\n\n");
+}
+
+void mkfile(void) {
+    int fd = open(path, O_CREATE | O_TRUNC | O_RDWR);
+    if (fd < 0) {
+        printf("Error: cannot create %s\n", path);
+        exit(1);
+    }
+    for (int off = 0; off < FSIZE; off += sizeof(buf)) {
+        for (int i = 0; i < sizeof(buf); i++)
+            buf[i] = pattern(off + i);
+        if (write(fd, buf, sizeof(buf)) != sizeof(buf)) {
+            printf("Error: write failed\n");
+            exit(1);
+        }
+    }
+    close(fd);
+}
+
+// Read byte off of the file with read().
+char fileat(int off) {
+    char c = 0;
+    int fd = open(path, O_RDONLY);
+    for (int n = 0; n <= off / sizeof(buf); n++)
+        read(fd, buf, sizeof(buf));
+    c = buf[off % sizeof(buf)];
+    close(fd);
+    return c;
+}
+
+int main(int argc, char *argv[]) {
+    int fd, ok;
+    char *p;
+
+    printf("========================================\n");
+    printf("  mmap() Test and Benchmark\n");
+    printf("========================================\n\n");
+    mkfile();
+
+    printf("Test 1: MAP_PRIVATE read matches the file\n");
+    fd = open(path, O_RDONLY);
+    p = mmap(0, FSIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);  // the mapping keeps its own reference
+    ok = p != MAP_FAILED;
+    for (int i = 0; ok && i < FSIZE; i++)
+        if (p[i] != pattern(i))
+            ok = 0;
+    ok = ok && munmap(p, FSIZE) == 0;
+    result(ok);
+
+    printf("Test 2: MAP_PRIVATE stores stay private\n");
+    fd = open(path, O_RDONLY);
+    p = mmap(0, FSIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    close(fd);
+    ok = p != MAP_FAILED;
+    if (ok) {
+        p[0] = '#';
+        ok = p[0] == '#' && munmap(p, FSIZE) == 0 && fileat(0) == pattern(0);
+    }
+    result(ok);
+
+    printf("Test 3: MAP_SHARED stores reach the file\n");
+    fd = open(path, O_RDWR);
+    p = mmap(0, FSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ok = p != MAP_FAILED;
+    if (ok) {
+        p[5000] = '!';
+        // a read-only descriptor can't map shared and writable.
+        int rfd = open(path, O_RDONLY);
+        ok = mmap(0, 4096, PROT_WRITE, MAP_SHARED, rfd, 0) == MAP_FAILED;
+        close(rfd);
+        // unmap the middle page, splitting the region.
+        ok = ok && munmap(p + 4096, 4096) == 0 && p[0] == pattern(0);
+        ok = ok && munmap(p, FSIZE) == 0 && fileat(5000) == '!';
+    }
+    close(fd);
+    result(ok);
+
+    printf("Test 4: MAP_SHARED is shared with a forked child\n");
+    fd = open(path, O_RDWR);
+    p = mmap(0, 4096, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    ok = p != MAP_FAILED;
+    if (ok) {
+        p[0] = 'P';
+        int pid = fork();
+        if (pid == 0) {
+            p[1] = 'C';
+            exit(p[0] == 'P' ? 0 : 1);
+        }
+        int status;
+        wait(&status);
+        ok = status == 0 && p[1] == 'C' && munmap(p, 4096) == 0;
+    }
+    result(ok);
+
+    printf("Test 5: MAP_SHARED mappings, read() and write() agree\n");
+    fd = open(path, O_RDWR);
+    p = mmap(0, 8192, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    char *q = mmap(0, 8192, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    ok = p != MAP_FAILED && q != MAP_FAILED && p != q;
+    if (ok) {
+        // one page behind both mappings, seen by read()
+        // before anything is written back.
+        p[100] = 'X';
+        ok = q[100] == 'X' && fileat(100) == 'X';
+        fd = open(path, O_WRONLY);
+        ok = ok && write(fd, "Z", 1) == 1 && p[0] == 'Z' && q[0] == 'Z';
+        close(fd);
+        ok = ok && munmap(p, 8192) == 0 && q[100] == 'X';
+        ok = ok && munmap(q, 8192) == 0 && fileat(100) == 'X' && fileat(0) == 'Z';
+    }
+    result(ok);
+
+    // Benchmark: sum the file NPASSES times each way.
+    uint sum1 = 0, sum2 = 0;
+    uint64 start = rdtime();
+    for (int pass = 0; pass < NPASSES; pass++) {
+        fd = open(path, O_RDONLY);
+        int n;
+        while ((n = read(fd, buf, sizeof(buf))) > 0)
+            for (int i = 0; i < n; i++)
+                sum1 += buf[i];
+        close(fd);
+    }
+    uint64 readtime = rdtime() - start;
+
+    start = rdtime();
+    fd = open(path, O_RDONLY);
+    p = mmap(0, FSIZE, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (p == MAP_FAILED) {
+        printf("Error: mmap failed\n");
+        exit(1);
+    }
+    for (int pass = 0; pass < NPASSES; pass++)
+        for (int i = 0; i < FSIZE; i++)
+            sum2 += p[i];
+    munmap(p, FSIZE);
+    uint64 mmaptime = rdtime() - start;
+
+    printf("Benchmark: sum a %d KB file %d times\n", FILE_KB, NPASSES);
+    printf("  read():              %d ms\n", (int)(readtime / CYCLES_PER_US / 1000));
+    printf("  mmap():              %d ms\n", (int)(mmaptime / CYCLES_PER_US / 1000));
+    result(sum1 == sum2);
+
+    unlink(path);
+    printf("========================================\n");
+    printf("  mmap() Test Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
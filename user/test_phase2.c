@@ -13,7 +13,7 @@ void test_memory_features(void) {
     printf("Free memory: %d KB\n", (int)(free_bytes / 1024));
     
     uint64 free_pages, total_alloc;
-    memstat(&free_pages, &total_alloc);
+    memstat(&free_pages, &total_alloc, 0, 0);
     printf("Free pages: %d, Total allocations: %d\n", (int)free_pages, (int)total_alloc);
     
     // Allocate and free to test tracking
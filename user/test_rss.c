@@ -0,0 +1,89 @@
+// Resident Set Test
+// Checks the per-process memory counters from getminfo(): a lazy
+// sbrk() heap costs nothing until touched, touching it raises RSS
+// page for page, shrinking it lowers RSS but not the peak, and a
+// forked child is charged for the pages it shares with its parent.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/mman.h"
+#include "kernel/meminfo.h"
+#include "user/user.h"
+
+#define NPAGES 256
+
+struct minfo table[NPROC];
+
+void result(int ok) {
+    printf(ok ? "  Result: PASSED\n\n" : "  Result: FAILED\n\n");
+}
+
+// This process's counters.
+struct minfo self(void) {
+    int me = getpid();
+    int n = getminfo(table, NPROC);
+
+    for (int i = 0; i < n; i++)
+        if (table[i].pid == me)
+            return table[i];
+    printf("Error: not in getminfo()\n");
+    exit(1);
+}
+
+int main(int argc, char *argv[]) {
+    struct minfo m0, m1, m2;
+    int status;
+
+    printf("========================================\n");
+    printf("  Resident Set Test\n");
+    printf("========================================\n\n");
+
+    // count 4 KiB pages, not megapages.
+    madvise(0, 0, MADV_NOHUGEPAGE);
+
+    printf("Test 1: a lazy heap is not resident until touched\n");
+    m0 = self();
+    char *heap = sbrklazy(NPAGES * 4096);
+    if (heap == SBRK_ERROR) {
+        printf("Error: sbrklazy failed\n");
+        exit(1);
+    }
+    m1 = self();
+    printf("  rss %d -> %d pages, %d page-table pages\n", m0.rss, m1.rss,
+           m1.ptpages);
+    result(m1.rss == m0.rss && m1.sz == m0.sz + NPAGES * 4096 && m1.ptpages > 0);
+
+    printf("Test 2: touching the heap makes it resident\n");
+    for (int i = 0; i < NPAGES; i++)
+        heap[i * 4096] = 1;
+    m2 = self();
+    printf("  rss %d -> %d pages after %d faults\n", m1.rss, m2.rss,
+           m2.faults - m1.faults);
+    result(m2.rss >= m1.rss + NPAGES && m2.peak >= m2.rss);
+
+    printf("Test 3: a forked child is charged for shared pages\n");
+    int pid = fork();
+    if (pid < 0) {
+        printf("  fork failed\n");
+        result(0);
+    } else {
+        if (pid == 0) {
+            struct minfo c = self();
+            exit(c.rss >= NPAGES ? 0 : 1);
+        }
+        wait(&status);
+        result(status == 0);
+    }
+
+    printf("Test 4: shrinking lowers rss but not the peak\n");
+    sbrk(-NPAGES * 4096);
+    m1 = self();
+    printf("  rss %d, peak %d pages\n", m1.rss, m1.peak);
+    result(m1.rss + NPAGES <= m2.rss && m1.peak >= m2.rss);
+
+    printf("========================================\n");
+    printf("  Resident Set Test Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
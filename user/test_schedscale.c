@@ -0,0 +1,109 @@
+// Context-Switch Scaling Benchmark for the per-CPU Lottery Scheduler
+// Pairs of processes ping-pong a byte through two pipes, so every
+// round trip costs two sleep/wakeup context switches. Run it under
+// make qemu CPUS=1, CPUS=2, ... CPUS=8 and compare the switch rate.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NPAIRS 8                // Default ping-pong pairs
+#define MAXPAIRS 16
+#define TEST_DURATION 50        // Run for this many ticks
+
+// One side of a ping-pong pair: read a byte, send it back,
+// count round trips until the deadline passes.
+int ping_pong(int rfd, int wfd, int starter, int deadline) {
+    char c = 'x';
+    int trips = 0;
+
+    if (starter && write(wfd, &c, 1) != 1)
+        return 0;
+    while (uptime() < deadline) {
+        if (read(rfd, &c, 1) != 1)
+            break;
+        if (write(wfd, &c, 1) != 1)
+            break;
+        trips++;
+    }
+    return trips;
+}
+
+int main(int argc, char *argv[]) {
+    int npairs = NPAIRS;
+    int results[2];
+    int total = 0;
+
+    if (argc > 1)
+        npairs = atoi(argv[1]);
+    if (npairs < 1 || npairs > MAXPAIRS) {
+        printf("usage: test_schedscale [npairs 1-%d]\n", MAXPAIRS);
+        exit(1);
+    }
+
+    printf("========================================\n");
+    printf("  Context-Switch Scaling Benchmark\n");
+    printf("========================================\n\n");
+    printf("Configuration:\n");
+    printf("  Ping-pong pairs:     %d\n", npairs);
+    printf("  Test duration:       %d ticks\n\n", TEST_DURATION);
+
+    if (pipe(results) < 0) {
+        printf("Error: pipe creation failed\n");
+        exit(1);
+    }
+
+    int deadline = uptime() + TEST_DURATION;
+
+    for (int i = 0; i < npairs; i++) {
+        int ab[2], ba[2];
+        if (pipe(ab) < 0 || pipe(ba) < 0) {
+            printf("Error: pipe creation failed\n");
+            exit(1);
+        }
+        for (int side = 0; side < 2; side++) {
+            int pid = fork();
+            if (pid < 0) {
+                printf("Error: fork failed\n");
+                exit(1);
+            }
+            if (pid == 0) {
+                int trips;
+                // close the ends this side doesn't use, so a read
+                // sees EOF once the peer exits.
+                close(results[0]);
+                if (side == 0) {
+                    close(ab[0]);
+                    close(ba[1]);
+                    trips = ping_pong(ba[0], ab[1], 1, deadline);
+                } else {
+                    close(ba[0]);
+                    close(ab[1]);
+                    trips = ping_pong(ab[0], ba[1], 0, deadline);
+                }
+                write(results[1], &trips, sizeof(trips));
+                exit(0);
+            }
+        }
+        close(ab[0]); close(ab[1]);
+        close(ba[0]); close(ba[1]);
+    }
+    close(results[1]);
+
+    for (int i = 0; i < 2 * npairs; i++) {
+        int trips;
+        if (read(results[0], &trips, sizeof(trips)) == sizeof(trips))
+            total += trips;
+        wait(0);
+    }
+    close(results[0]);
+
+    // Each side counts its own trips; every trip is two switches.
+    printf("Results:\n");
+    printf("  Round trips:         %d\n", total / 2);
+    printf("  Context switches:    %d\n", total);
+    printf("  Switches per tick:   %d\n\n", total / TEST_DURATION);
+    printf("Compare Switches per tick across CPUS=1..8 runs.\n");
+
+    exit(0);
+}
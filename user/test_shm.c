@@ -0,0 +1,162 @@
+// Shared Anonymous Memory Test
+// Checks that mmap(MAP_SHARED|MAP_ANON) memory is shared with forked
+// children in both directions and freed when the last process unmaps
+// it, then times moving data from a producer to a consumer through a
+// pipe against handing it over in shared memory.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/mman.h"
+#include "user/user.h"
+
+#define NPAGES 64
+#define CHUNK (64 * 1024)       // Bytes handed over per round
+#define TOTAL_MB 8
+#define ROUNDS (TOTAL_MB * 1024 * 1024 / CHUNK)
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+char buf[4096];
+
+void result(int ok) {
+    printf(ok ? "  Result: PASSED\n\n" : "  Result: FAILED\n\n");
+}
+
+void *shmalloc(int len) {
+    void *p = mmap(0, len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANON, -1, 0);
+    if (p == MAP_FAILED) {
+        printf("Error: mmap failed\n");
+        exit(1);
+    }
+    return p;
+}
+
+// Producer fills buffer chunks, consumer sums them.
+// Returns elapsed cycles; *sum gets the consumer's total.
+uint64 via_pipe(uint *sum) {
+    int data[2];
+    uint *shared = shmalloc(4096);
+
+    pipe(data);
+    uint64 start = rdtime();
+    if (fork() == 0) {
+        close(data[1]);
+        uint s = 0;
+        int n;
+        while ((n = read(data[0], buf, sizeof(buf))) > 0)
+            for (int i = 0; i < n; i++)
+                s += buf[i];
+        shared[0] = s;
+        exit(0);
+    }
+    close(data[0]);
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int off = 0; off < CHUNK; off += sizeof(buf)) {
+            for (int i = 0; i < sizeof(buf); i++)
+                buf[i] = r + i;
+            write(data[1], buf, sizeof(buf));
+        }
+    }
+    close(data[1]);
+    wait(0);
+    uint64 cycles = rdtime() - start;
+    *sum = shared[0];
+    munmap(shared, 4096);
+    return cycles;
+}
+
+uint64 via_shm(uint *sum) {
+    int ready[2], done[2];
+    char *chunk = shmalloc(CHUNK);
+    uint *shared = shmalloc(4096);
+    char c = 0;
+
+    pipe(ready);
+    pipe(done);
+    uint64 start = rdtime();
+    if (fork() == 0) {
+        close(ready[1]);
+        close(done[0]);
+        uint s = 0;
+        while (read(ready[0], &c, 1) == 1) {
+            for (int i = 0; i < CHUNK; i++)
+                s += chunk[i];
+            write(done[1], &c, 1);
+        }
+        shared[0] = s;
+        exit(0);
+    }
+    close(ready[0]);
+    close(done[1]);
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int off = 0; off < CHUNK; off += sizeof(buf))
+            for (int i = 0; i < sizeof(buf); i++)
+                chunk[off + i] = r + i;
+        write(ready[1], &c, 1);
+        read(done[0], &c, 1);       // consumer is done with chunk
+    }
+    close(ready[1]);
+    wait(0);
+    uint64 cycles = rdtime() - start;
+    *sum = shared[0];
+    close(done[0]);
+    munmap(chunk, CHUNK);
+    munmap(shared, 4096);
+    return cycles;
+}
+
+int main(int argc, char *argv[]) {
+    int ok, status;
+
+    printf("========================================\n");
+    printf("  Shared Anonymous Memory Test\n");
+    printf("========================================\n\n");
+
+    printf("Test 1: child and parent see each other's stores\n");
+    volatile int *p = shmalloc(NPAGES * 4096);
+    p[0] = 1;
+    int pid = fork();
+    if (pid == 0) {
+        // the last page was never touched before fork().
+        p[(NPAGES - 1) * 1024] = 42;
+        while (p[0] != 2)
+            ;
+        exit(0);
+    }
+    while (p[(NPAGES - 1) * 1024] != 42)
+        ;
+    p[0] = 2;
+    wait(&status);
+    result(status == 0);
+
+    printf("Test 2: pages are freed by the last munmap()\n");
+    uint64 free1, free2, allocs;
+    memstat(&free1, &allocs, 0, 0);
+    ok = munmap((void *)p, NPAGES * 4096) == 0;
+    memstat(&free2, &allocs, 0, 0);
+    printf("  %d pages freed\n", (int)(free2 - free1));
+    result(ok && free2 >= free1 + NPAGES);
+
+    printf("Test 3: a child's exit leaves the parent's pages\n");
+    p = shmalloc(4096);
+    pid = fork();
+    if (pid == 0) {
+        p[0] = 7;
+        exit(0);
+    }
+    wait(0);
+    result(p[0] == 7 && munmap((void *)p, 4096) == 0);
+
+    printf("Benchmark: hand %d MB to a consumer in %d KB chunks\n",
+           TOTAL_MB, CHUNK / 1024);
+    uint sum1, sum2;
+    uint64 pipetime = via_pipe(&sum1);
+    uint64 shmtime = via_shm(&sum2);
+    printf("  pipe:                %d ms\n", (int)(pipetime / CYCLES_PER_US / 1000));
+    printf("  shared memory:       %d ms\n", (int)(shmtime / CYCLES_PER_US / 1000));
+    result(sum1 == sum2);
+
+    printf("========================================\n");
+    printf("  Shared Anonymous Memory Test Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
@@ -0,0 +1,106 @@
+// Swap Test
+// Touches a lazy heap larger than free memory, so that the kernel has
+// to swap pages out to the swap area, and checks that every page
+// reads back intact, in the process itself and in a forked child that
+// shares its swapped-out pages. Then checks that shrinking the heap
+// frees the swap slots, and reports swap traffic from memstat().
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/mman.h"
+#include "kernel/swap.h"
+#include "user/user.h"
+
+#define OVERCOMMIT 2048         // pages past free memory, at most
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+void result(int ok) {
+    printf(ok ? "  Result: PASSED\n\n" : "  Result: FAILED\n\n");
+}
+
+void swapstat(struct swapstat *ss) {
+    uint64 freepages, allocs;
+    memstat(&freepages, &allocs, 0, ss);
+}
+
+// Check the words each page was stamped with.
+// Returns the number of bad pages.
+int check(uint64 *heap, int npages) {
+    int bad = 0;
+    for (int i = 0; i < npages; i++) {
+        uint64 *pg = heap + i * 512;
+        if (pg[0] != i * 2654435761UL || pg[511] != ~(uint64)i)
+            bad++;
+    }
+    return bad;
+}
+
+int main(int argc, char *argv[]) {
+    struct swapstat before, after;
+    uint64 freepages, allocs;
+    int status;
+
+    printf("========================================\n");
+    printf("  Swap Test\n");
+    printf("========================================\n\n");
+
+    swapstat(&before);
+    if (before.nslot == 0) {
+        printf("No swap area; skipping.\n");
+        exit(0);
+    }
+    memstat(&freepages, &allocs, 0, 0);
+    int over = before.nslot - before.inuse;
+    if (over > OVERCOMMIT)
+        over = OVERCOMMIT;
+    int npages = freepages + over / 2;
+    printf("%d free pages, %d swap slots; touching %d pages\n\n",
+           (int)freepages, (int)before.nslot, npages);
+
+    // megapages are never swapped out.
+    madvise(0, 0, MADV_NOHUGEPAGE);
+    uint64 *heap = (uint64 *)sbrklazy(npages * 4096);
+    if (heap == (uint64 *)SBRK_ERROR) {
+        printf("Error: sbrklazy failed\n");
+        exit(1);
+    }
+
+    printf("Test 1: pages read back intact after swapping\n");
+    uint64 start = rdtime();
+    for (int i = 0; i < npages; i++) {
+        uint64 *pg = heap + i * 512;
+        pg[0] = i * 2654435761UL;
+        pg[511] = ~(uint64)i;
+    }
+    int bad = check(heap, npages);
+    uint64 cycles = rdtime() - start;
+    swapstat(&after);
+    printf("  %d pages out, %d in, %d ms\n",
+           (int)(after.swapouts - before.swapouts),
+           (int)(after.swapins - before.swapins),
+           (int)(cycles / CYCLES_PER_US / 1000));
+    result(bad == 0 && after.swapouts > before.swapouts);
+
+    printf("Test 2: a forked child shares swapped-out pages\n");
+    int pid = fork();
+    if (pid < 0) {
+        printf("  fork failed\n");
+        result(0);
+    } else {
+        if (pid == 0)
+            exit(check(heap, npages) == 0 ? 0 : 1);
+        wait(&status);
+        result(status == 0 && check(heap, npages) == 0);
+    }
+
+    printf("Test 3: shrinking the heap frees swap slots\n");
+    sbrk(-npages * 4096);
+    swapstat(&after);
+    printf("  %d slots in use\n", (int)after.inuse);
+    result(after.inuse <= before.inuse);
+
+    printf("========================================\n");
+    printf("  Swap Test Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
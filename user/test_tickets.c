@@ -0,0 +1,195 @@
+// Ticket Transfer and Currency Test for the Lottery Scheduler
+// Checks that a blocked process can lend its tickets to the
+// process it waits on, and that a currency caps a group's share
+// however many children it forks.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define TEST_DURATION 100       // Run each contest for this many ticks
+#define WORK_UNITS 50000        // Work per measurement cycle
+#define GROUP_SIZE 4            // Processes sharing one currency
+#define GROUP_FUNDING 10        // Base tickets funding the currency
+#define SOLO_TICKETS 10         // Tickets of the process outside it
+
+int do_work_chunk(void) {
+    volatile int k = 0;
+    for (int i = 0; i < WORK_UNITS; i++) {
+        k = i * i + k;
+    }
+    return k;
+}
+
+// Spin until the deadline, then report the work done.
+void spinner(int deadline, int fd) {
+    int work = 0;
+    while (uptime() < deadline) {
+        do_work_chunk();
+        work++;
+    }
+    write(fd, &work, sizeof(work));
+    exit(0);
+}
+
+// Sum the work reports from n children.
+int collect(int fd, int n) {
+    int total = 0, work;
+    for (int i = 0; i < n; i++) {
+        if (read(fd, &work, sizeof(work)) == sizeof(work))
+            total += work;
+    }
+    return total;
+}
+
+int main(int argc, char *argv[]) {
+    int group[2], solo[2];
+    int deadline;
+
+    printf("========================================\n");
+    printf("  Ticket Transfer and Currency Test\n");
+    printf("========================================\n\n");
+
+    // Test 1: lending to a bad pid, to ourselves or around a loop
+    // fails; cancelling always works.
+    printf("Test 1: lendtickets() arguments\n");
+    int ok = lendtickets(-5) == -1 && lendtickets(getpid()) == -1 &&
+             lendtickets(0) == 0;
+    if (pipe(group) < 0) {
+        printf("Error: pipe creation failed\n");
+        exit(1);
+    }
+    int parent = getpid(), child = fork();
+    if (child == 0) {
+        close(group[0]);
+        char r = lendtickets(parent) == 0;
+        write(group[1], &r, 1);
+        sleep(1000);                // until our parent kills us
+        exit(0);
+    }
+    close(group[1]);
+    char r = 0;
+    ok = ok && read(group[0], &r, 1) == 1 && r;
+    ok = ok && lendtickets(child) == -1;
+    kill(child);
+    close(group[0]);
+    wait(0);
+    if (ok)
+        printf("  Result: PASSED\n\n");
+    else
+        printf("  Result: FAILED\n\n");
+
+    // Test 2: a group of GROUP_SIZE processes in one currency
+    // funded with GROUP_FUNDING tickets competes with a single
+    // process holding SOLO_TICKETS base tickets.
+    printf("Test 2: Currency caps a forking group\n");
+    printf("  %d processes in a %d-ticket currency vs 1 process with %d tickets\n",
+           GROUP_SIZE, GROUP_FUNDING, SOLO_TICKETS);
+    if (pipe(group) < 0 || pipe(solo) < 0) {
+        printf("Error: pipe creation failed\n");
+        exit(1);
+    }
+    deadline = uptime() + TEST_DURATION;
+    if (fork() == 0) {
+        close(group[0]);
+        if (mkcurrency(GROUP_FUNDING) < 0) {
+            printf("  mkcurrency failed\n");
+            exit(1);
+        }
+        for (int i = 1; i < GROUP_SIZE; i++) {
+            if (fork() == 0)
+                spinner(deadline, group[1]);
+        }
+        spinner(deadline, group[1]);
+    }
+    if (fork() == 0) {
+        close(solo[0]);
+        settickets(SOLO_TICKETS);
+        spinner(deadline, solo[1]);
+    }
+    close(group[1]);
+    close(solo[1]);
+    int work_group = collect(group[0], GROUP_SIZE);
+    int work_solo = collect(solo[0], 1);
+    close(group[0]);
+    close(solo[0]);
+    while (wait(0) > 0)
+        ;
+    printf("  Group work: %d cycles, solo work: %d cycles\n", work_group, work_solo);
+    if (work_group > 0 && work_solo > 0) {
+        int ratio_x100 = (work_group * 100) / work_solo;
+        printf("  Group/solo ratio: %d.%d%d (uncapped would be %d.00)\n",
+               ratio_x100 / 100, (ratio_x100 / 10) % 10, ratio_x100 % 10,
+               GROUP_SIZE);
+        if (ratio_x100 < GROUP_SIZE * 100)
+            printf("  Result: PASSED\n\n");
+        else
+            printf("  Result: VARIANCE (more CPUs than runnable processes?)\n\n");
+    } else {
+        printf("  Result: FAILED (no work reported)\n\n");
+    }
+
+    // Test 3: a 1-ticket server competes with a 10-ticket spinner
+    // while a 100-ticket client blocks reading from the server
+    // and lends it its tickets.  The client passes the server's
+    // work on to us.
+    printf("Test 3: Blocked client lends tickets to its server\n");
+    int req[2], res[2];
+    if (pipe(req) < 0 || pipe(res) < 0 || pipe(group) < 0 || pipe(solo) < 0) {
+        printf("Error: pipe creation failed\n");
+        exit(1);
+    }
+    deadline = uptime() + TEST_DURATION;
+    int server = fork();
+    if (server == 0) {
+        close(res[0]);
+        close(req[1]);
+        settickets(1);
+        char c;
+        read(req[0], &c, 1);        // wait for the client to lend
+        spinner(deadline, res[1]);
+    }
+    if (fork() == 0) {
+        close(res[1]);
+        close(req[0]);
+        close(group[0]);
+        settickets(100);
+        if (lendtickets(server) < 0) {
+            printf("  lendtickets failed\n");
+            exit(1);
+        }
+        write(req[1], "g", 1);
+        int work;
+        if (read(res[0], &work, sizeof(work)) == sizeof(work))  // blocks, lending tickets
+            write(group[1], &work, sizeof(work));
+        exit(0);
+    }
+    if (fork() == 0) {
+        close(solo[0]);
+        settickets(SOLO_TICKETS);
+        spinner(deadline, solo[1]);
+    }
+    close(req[0]); close(req[1]);
+    close(res[0]); close(res[1]);
+    close(group[1]);
+    close(solo[1]);
+    int work_server = collect(group[0], 1);
+    int work_spinner = collect(solo[0], 1);
+    close(group[0]);
+    close(solo[0]);
+    while (wait(0) > 0)
+        ;
+    printf("  Server (1 ticket + lent 100) work: %d cycles\n", work_server);
+    printf("  Spinner (%d tickets) work: %d cycles\n", SOLO_TICKETS, work_spinner);
+    if (work_server == 0 || work_spinner == 0)
+        printf("  Result: FAILED (no work reported)\n");
+    else if (work_server > work_spinner)
+        printf("  Result: PASSED\n");
+    else
+        printf("  Result: VARIANCE (more CPUs than runnable processes?)\n");
+
+    printf("\n========================================\n");
+    printf("  Ticket Transfer Test Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
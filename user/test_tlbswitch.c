@@ -0,0 +1,106 @@
+// TLB Context-Switch Benchmark
+// Two processes ping-pong a byte through a pair of pipes, each
+// reading a word from every page of its own working set before
+// passing the byte back. With ASIDs the TLB keeps both processes'
+// entries across the switches, so the round-trip time grows
+// little with the working set; a kernel that flushes the TLB on
+// every switch refills it each turn. Run with CPUS=1 so that
+// every round trip is two context switches on one CPU.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define MAXPAGES 128
+#define ROUNDS 2000
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+// Read a word from each of the first npages pages of mem.
+int touch(char *mem, int npages) {
+    int sum = 0;
+
+    for (int i = 0; i < npages; i++)
+        sum += *(volatile int *)(mem + i * PGSIZE);
+    return sum;
+}
+
+// Time ROUNDS round trips between two processes that each touch
+// npages pages per turn. Returns cycles per round trip.
+uint64 pingpong(char *mem, int npages) {
+    int ping[2], pong[2];
+    char c = 0;
+    uint64 start;
+
+    if (pipe(ping) < 0 || pipe(pong) < 0) {
+        printf("Error: pipe creation failed\n");
+        exit(1);
+    }
+    if (fork() == 0) {
+        close(ping[1]);
+        close(pong[0]);
+        // the child's own copies of the pages, after copy-on-write.
+        for (int i = 0; i < npages; i++)
+            mem[i * PGSIZE] = 1;
+        while (read(ping[0], &c, 1) == 1) {
+            touch(mem, npages);
+            write(pong[1], &c, 1);
+        }
+        exit(0);
+    }
+    close(ping[0]);
+    close(pong[1]);
+
+    // one warm-up round trip.
+    write(ping[1], &c, 1);
+    read(pong[0], &c, 1);
+
+    start = rdtime();
+    for (int r = 0; r < ROUNDS; r++) {
+        touch(mem, npages);
+        write(ping[1], &c, 1);
+        read(pong[0], &c, 1);
+    }
+    uint64 cycles = rdtime() - start;
+
+    close(ping[1]);
+    close(pong[0]);
+    wait(0);
+    return cycles / ROUNDS;
+}
+
+int main(int argc, char *argv[]) {
+    int sizes[] = {1, 8, 32, 64, MAXPAGES};
+    int nsizes = sizeof(sizes) / sizeof(sizes[0]);
+    uint64 base = 0;
+
+    printf("========================================\n");
+    printf("  TLB Context-Switch Benchmark\n");
+    printf("========================================\n\n");
+
+    char *mem = sbrk(MAXPAGES * PGSIZE);
+    if (mem == SBRK_ERROR) {
+        printf("Error: sbrk failed\n");
+        exit(1);
+    }
+    for (int i = 0; i < MAXPAGES; i++)
+        mem[i * PGSIZE] = 1;
+
+    printf("  pages\tus/round trip\textra ns/page\n");
+    for (int i = 0; i < nsizes; i++) {
+        uint64 cycles = pingpong(mem, sizes[i]);
+        if (i == 0)
+            base = cycles;
+        int perpage = 0;
+        if (i > 0 && cycles > base)
+            perpage = (int)((cycles - base) * 1000 / CYCLES_PER_US /
+                            (2 * (sizes[i] - sizes[0])));
+        printf("  %d\t%d\t\t%d\n", sizes[i], (int)(cycles / CYCLES_PER_US), perpage);
+    }
+    printf("\n");
+
+    printf("========================================\n");
+    printf("  TLB Context-Switch Benchmark Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
@@ -0,0 +1,116 @@
+// User-Copy Path Test
+// Checks system-call copies into and out of user memory in the
+// cases a kernel built with KPGTBL handles by faulting inside the
+// copy: lazy heap pages, buffers and path names that straddle a
+// page boundary, read-only text and the stack guard page. Then
+// times fstat() and open()/close(), whose costs are mostly the
+// argument copies. Passes with or without KPGTBL.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define PGSIZE 4096
+#define NCALLS 2000
+#define CYCLES_PER_US 10        // qemu's time CSR runs at 10 MHz
+
+char *path = "ucopyfile";
+
+void result(int ok) {
+    printf(ok ? "  Result: PASSED\n\n" : "  Result: FAILED\n\n");
+}
+
+void report(char *label, uint64 cycles) {
+    int ns = (int)(cycles * 1000 / CYCLES_PER_US / NCALLS);
+    printf("  %s:\t%d ns/call\n", label, ns);
+}
+
+int main(int argc, char *argv[]) {
+    struct stat st;
+    int fds[2], fd, ok;
+    char *heap;
+    uint64 start;
+
+    printf("========================================\n");
+    printf("  User-Copy Path Test\n");
+    printf("========================================\n\n");
+
+    if ((fd = open(path, O_CREATE | O_WRONLY)) < 0) {
+        printf("Error: cannot create %s\n", path);
+        exit(1);
+    }
+    write(fd, "ucopy", 5);
+    close(fd);
+
+    // untouched pages, faulted in by the kernel's copy.
+    heap = sbrklazy(4 * PGSIZE);
+    if (heap == SBRK_ERROR) {
+        printf("Error: sbrklazy failed\n");
+        exit(1);
+    }
+
+    printf("Test 1: read() and write() across lazy heap pages\n");
+    if (pipe(fds) < 0) {
+        printf("Error: pipe creation failed\n");
+        exit(1);
+    }
+    char *a = heap + PGSIZE - 100;      // 200 bytes over a page boundary
+    ok = write(fds[1], a, 200) == 200;
+    for (int i = 0; i < 200; i++)
+        a[i] = i;
+    ok = ok && write(fds[1], a, 200) == 200;
+    char *b = heap + 3 * PGSIZE - 100;
+    ok = ok && read(fds[0], b, 200) == 200;
+    for (int i = 0; i < 200; i++)
+        ok = ok && b[i] == 0;
+    ok = ok && read(fds[0], b, 200) == 200;
+    for (int i = 0; i < 200; i++)
+        ok = ok && b[i] == (char)i;
+    close(fds[0]);
+    close(fds[1]);
+    result(ok);
+
+    printf("Test 2: path names in lazy pages and across a page boundary\n");
+    char *p1 = heap + 2 * PGSIZE - 4;   // "ucop" | "yfile"
+    strcpy(p1, path);
+    fd = open(p1, O_RDONLY);
+    ok = fd >= 0;
+    close(fd);
+    // the last byte of the heap with no NUL after it.
+    char *end = heap + 4 * PGSIZE - 1;
+    *end = 'x';
+    ok = ok && open(end, O_RDONLY) < 0;
+    result(ok);
+
+    printf("Test 3: copies into read-only text and the stack guard fail\n");
+    fd = open(path, O_RDONLY);
+    char *guard = (char *)((((uint64)&fd + PGSIZE - 1) & ~(PGSIZE - 1)) -
+                           (USERSTACK + 1) * PGSIZE);
+    ok = fstat(fd, (struct stat *)main) < 0;
+    ok = ok && fstat(fd, (struct stat *)guard) < 0;
+    ok = ok && fstat(fd, (struct stat *)(guard + PGSIZE - 8)) < 0;
+    ok = ok && fstat(fd, &st) == 0 && st.size == 5;
+    close(fd);
+    result(ok);
+
+    printf("Test 4: system-call copy cost\n");
+    fd = open(path, O_RDONLY);
+    start = rdtime();
+    for (int i = 0; i < NCALLS; i++)
+        fstat(fd, &st);
+    report("fstat", rdtime() - start);
+    close(fd);
+    start = rdtime();
+    for (int i = 0; i < NCALLS; i++)
+        close(open(path, O_RDONLY));
+    report("open+close", rdtime() - start);
+    printf("\n");
+
+    unlink(path);
+    printf("========================================\n");
+    printf("  User-Copy Path Test Complete\n");
+    printf("========================================\n");
+    exit(0);
+}
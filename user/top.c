@@ -0,0 +1,97 @@
+// top: live view of per-process scheduling statistics.
+// Every second, shows each process's CPU use since the last
+// screen next to its share of the active tickets, so ticket
+// shares can be checked under a real load.
+//
+// usage: top [count]   (count screens, default forever)
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/sched.h"
+#include "user/user.h"
+
+#define INTERVAL 10             // Ticks between screens
+#define RUNNABLE 3              // enum procstate values
+#define RUNNING 4
+
+static char *states[] = { "unused", "used", "sleep", "runble", "run", "zombie" };
+
+struct pinfo cur[NPROC], prev[NPROC];
+int ncur, nprev;
+
+// Find pid in the previous screen's table.
+struct pinfo *lookup(int pid) {
+    for (int i = 0; i < nprev; i++)
+        if (prev[i].pid == pid)
+            return &prev[i];
+    return 0;
+}
+
+// Print v/total as a percentage with one decimal.
+void percent(uint64 v, uint64 total) {
+    int x10 = total ? (int)(v * 1000 / total) : 0;
+    printf("%d.%d%%", x10 / 10, x10 % 10);
+    if (x10 < 1000)
+        printf(" ");
+    if (x10 < 100)
+        printf(" ");
+}
+
+void screen(uint64 elapsed) {
+    uint64 used = 0, tickets = 0, run[NPROC];
+
+    for (int i = 0; i < ncur; i++) {
+        struct pinfo *o = lookup(cur[i].pid);
+        run[i] = cur[i].runtime - (o ? o->runtime : 0);
+        used += run[i];
+        if (cur[i].state == RUNNABLE || cur[i].state == RUNNING)
+            tickets += cur[i].effective;
+    }
+
+    printf("\033[H\033[J");
+    printf("top - %d processes, %d ms of CPU in the last %d ms\n\n",
+           ncur, (int)(used / 10000), (int)(elapsed / 10000));
+    printf("PID\tSTATE\tCPU\tTICKETS\t%%CPU    SHARE   TKT%%    PICKS\tVCSW\tIVCSW\tWAITms\tNAME\n");
+    for (int i = 0; i < ncur; i++) {
+        struct pinfo *p = &cur[i];
+        int active = p->state == RUNNABLE || p->state == RUNNING;
+        printf("%d\t%s\t%d\t%d\t", p->pid,
+               p->state >= 0 && p->state < 6 ? states[p->state] : "???",
+               p->cpu, p->tickets);
+        percent(run[i], elapsed);
+        printf("  ");
+        percent(run[i], used);
+        printf("  ");
+        percent(active ? p->effective : 0, tickets);
+        printf("  %d\t%d\t%d\t%d\t%s\n", p->picks, p->nvcsw, p->nivcsw,
+               (int)(p->waittime / 10000), p->name);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    int count = -1;
+    uint64 last, now;
+
+    if (argc > 1)
+        count = atoi(argv[1]);
+
+    nprev = getpinfo(prev, NPROC);
+    last = rdtime();
+    if (nprev < 0) {
+        printf("top: getpinfo failed\n");
+        exit(1);
+    }
+    while (count != 0) {
+        pause(INTERVAL);
+        ncur = getpinfo(cur, NPROC);
+        now = rdtime();
+        screen(now - last);
+        memmove(prev, cur, sizeof(cur));
+        nprev = ncur;
+        last = now;
+        if (count > 0)
+            count--;
+    }
+    exit(0);
+}
@@ -46,17 +46,6 @@ strlen(const char *s)
   return n;
 }
 
-void*
-memset(void *dst, int c, uint n)
-{
-  char *cdst = (char *) dst;
-  int i;
-  for(i = 0; i < n; i++){
-    cdst[i] = c;
-  }
-  return dst;
-}
-
 char*
 strchr(const char *s, char c)
 {
@@ -109,46 +98,6 @@ atoi(const char *s)
   return n;
 }
 
-void*
-memmove(void *vdst, const void *vsrc, int n)
-{
-  char *dst;
-  const char *src;
-
-  dst = vdst;
-  src = vsrc;
-  if (src > dst) {
-    while(n-- > 0)
-      *dst++ = *src++;
-  } else {
-    dst += n;
-    src += n;
-    while(n-- > 0)
-      *--dst = *--src;
-  }
-  return vdst;
-}
-
-int
-memcmp(const void *s1, const void *s2, uint n)
-{
-  const char *p1 = s1, *p2 = s2;
-  while (n-- > 0) {
-    if (*p1 != *p2) {
-      return *p1 - *p2;
-    }
-    p1++;
-    p2++;
-  }
-  return 0;
-}
-
-void *
-memcpy(void *dst, const void *src, uint n)
-{
-  return memmove(dst, src, n);
-}
-
 char *
 sbrk(int n) {
   return sys_sbrk(n, SBRK_EAGER);
@@ -159,3 +108,11 @@ sbrklazy(int n) {
   return sys_sbrk(n, SBRK_LAZY);
 }
 
+
+// Read the time CSR: timer cycles since boot,
+// about 10,000,000 per second on qemu.
+uint64
+rdtime(void)
+{
+  return r_time();
+}
@@ -1,6 +1,11 @@
 #define SBRK_ERROR ((char *)-1)
 
 struct stat;
+struct pinfo;
+struct slabinfo;
+struct swapstat;
+struct minfo;
+struct iovec;
 
 // system calls
 int fork(void);
@@ -26,7 +31,7 @@ int pause(int);
 int uptime(void);
 int settickets(int);
 // Phase 2: Memory and File System Enhancements
-int memstat(uint64*, uint64*);
+int memstat(uint64*, uint64*, uint64*, struct swapstat*);
 int encrypt(char*, int);
 int decrypt(char*, int);
 uint64 freemem(void);
@@ -35,11 +40,27 @@ int buffer_init(void);
 int produce(int);
 int consume(int*);
 int buffer_status(int*, int*, int*);
+// Scheduler performance work
+int setsched(int);
+int lendtickets(int);
+int mkcurrency(int);
+int setquantum(int);
+int settickless(int);
+int getpinfo(struct pinfo*, int);
+int slabstat(struct slabinfo*, int);
+int madvise(void*, int, int);
+void* mmap(void*, int, int, int, int, int);
+int munmap(void*, int);
+int readv(int, const struct iovec*, int);
+int writev(int, const struct iovec*, int);
+int getminfo(struct minfo*, int);
+int setmemlimit(int);
+int mkmemgroup(int);
 
 // ulib.c
 int stat(const char*, struct stat*);
 char* strcpy(char*, const char*);
-void *memmove(void*, const void*, int);
+void *memmove(void*, const void*, uint);
 char* strchr(const char*, char c);
 int strcmp(const char*, const char*);
 char* gets(char*, int max);
@@ -50,6 +71,7 @@ int memcmp(const void *, const void *, uint);
 void *memcpy(void *, const void *, uint);
 char* sbrk(int);
 char* sbrklazy(int);
+uint64 rdtime(void);
 
 // printf.c
 void fprintf(int, const char*, ...) __attribute__ ((format (printf, 2, 3)));
@@ -53,3 +53,19 @@ entry("buffer_init");
 entry("produce");
 entry("consume");
 entry("buffer_status");
+# Scheduler performance work
+entry("setsched");
+entry("lendtickets");
+entry("mkcurrency");
+entry("setquantum");
+entry("settickless");
+entry("getpinfo");
+entry("slabstat");
+entry("madvise");
+entry("mmap");
+entry("munmap");
+entry("readv");
+entry("writev");
+entry("getminfo");
+entry("setmemlimit");
+entry("mkmemgroup");